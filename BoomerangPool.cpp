@@ -0,0 +1,68 @@
+#include "BoomerangPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+const double BoomerangPool::BOOMERANG_MAX_SPEED = std::sqrt(256 * 1.95 * BoomerangPool::BOOMERANG_ACCELERATION);
+
+BoomerangPool::BoomerangPool() {
+	at.fill(glm::vec2(0.0f, 240.0f));
+	prev_at.fill(glm::vec2(0.0f, 240.0f));
+	vec_x.fill(0.0);
+	state.fill(BoomerangState::INACTIVE);
+	holding_time.fill(0.0);
+
+	//all slots start free; lowest indices are handed out first:
+	for (uint32_t i = 0; i < Capacity; ++i) {
+		free_list[i] = uint16_t(Capacity - 1 - i);
+	}
+	free_count = Capacity;
+}
+
+uint32_t BoomerangPool::allocate(glm::vec2 const &at_) {
+	if (free_count == 0) return None;
+	uint32_t index = free_list[--free_count];
+	assert(state[index] == BoomerangState::INACTIVE);
+
+	at[index] = at_;
+	prev_at[index] = at_;
+	vec_x[index] = 0.0;
+	state[index] = BoomerangState::HOLDING;
+	holding_time[index] = 0.0;
+	return index;
+}
+
+void BoomerangPool::release(uint32_t index) {
+	assert(index < Capacity);
+	assert(state[index] != BoomerangState::INACTIVE);
+	assert(free_count < Capacity);
+
+	state[index] = BoomerangState::INACTIVE;
+	vec_x[index] = 0.0;
+	free_list[free_count++] = uint16_t(index);
+}
+
+void BoomerangPool::launch(uint32_t index) {
+	assert(index < Capacity);
+	assert(state[index] == BoomerangState::HOLDING);
+
+	state[index] = BoomerangState::FLYING;
+	vec_x[index] = std::min< double >(BOOMERANG_INIT_SPEED_COEFFICIENT * holding_time[index], BOOMERANG_MAX_SPEED);
+}
+
+void BoomerangPool::update(float elapsed) {
+	for (uint32_t i = 0; i < Capacity; ++i) {
+		prev_at[i] = at[i];
+		if (state[i] == BoomerangState::HOLDING) {
+			holding_time[i] += elapsed;
+		} else if (state[i] == BoomerangState::FLYING) {
+			at[i].x += (float)(vec_x[i] * elapsed);
+			vec_x[i] -= BOOMERANG_ACCELERATION * elapsed;
+			if (at[i].x <= 0) {
+				at[i].x = 0;
+				release(i);
+			}
+		}
+	}
+}
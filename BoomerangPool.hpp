@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ * BoomerangPool -- fixed-capacity storage for every boomerang in play.
+ *
+ * Boomerangs are stored structure-of-arrays style (one array per field),
+ *  and free slots are tracked with a free list, so allocating and releasing
+ *  boomerangs never touches the heap during play.
+ *
+ */
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+
+struct BoomerangPool {
+	BoomerangPool();
+
+	//The pool holds at most this many boomerangs at once:
+	enum : uint32_t {
+		Capacity = 256,
+		None = Capacity //<-- index returned by allocate() when the pool is full
+	};
+
+	//Flight model:
+	// a boomerang leaves with speed proportional to how long it was held (capped at BOOMERANG_MAX_SPEED),
+	// then decelerates at BOOMERANG_ACCELERATION until it comes back to x = 0.
+	static constexpr double BOOMERANG_INIT_SPEED_COEFFICIENT = 300;
+	static constexpr double BOOMERANG_ACCELERATION = 100;
+	static const double BOOMERANG_MAX_SPEED;
+
+	//INACTIVE slots are on the free list:
+	enum class BoomerangState : uint8_t { INACTIVE, HOLDING, FLYING };
+
+	//take a slot off the free list and start HOLDING a boomerang at 'at':
+	// returns None if all slots are in use.
+	uint32_t allocate(glm::vec2 const &at);
+
+	//put a slot back on the free list:
+	void release(uint32_t index);
+
+	//switch a HOLDING boomerang to FLYING, with speed based on its holding time:
+	void launch(uint32_t index);
+
+	//advance all boomerangs by 'elapsed' seconds:
+	// HOLDING boomerangs accumulate holding time,
+	// FLYING boomerangs move, and are released when they come back to x <= 0.
+	void update(float elapsed);
+
+	//number of slots currently in use (HOLDING or FLYING):
+	uint32_t active_count() const { return Capacity - free_count; }
+
+	//----- per-boomerang state (valid where state != INACTIVE) -----
+	std::array< glm::vec2, Capacity > at;
+	std::array< glm::vec2, Capacity > prev_at; //position at the start of the most recent update() (for swept collision)
+	std::array< double, Capacity > vec_x;
+	std::array< BoomerangState, Capacity > state;
+	std::array< double, Capacity > holding_time; //only used when state == HOLDING
+
+	//----- free list -----
+	// free_list[0 .. free_count) are the indices of INACTIVE slots:
+	std::array< uint16_t, Capacity > free_list;
+	uint32_t free_count = 0;
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+/*
+ * Checksum -- streaming 64-bit hash (the XXH64 algorithm from xxHash), for fingerprinting
+ *  game and PPU state every frame (see GameState::checksum, PPU466::checksum).
+ *
+ * Bulk data is consumed 32 bytes at a time in four independent 64-bit lanes,
+ *  so it runs at several bytes per cycle; small pieces are buffered until a stripe is full,
+ *  so it is fine to add() a structure field by field.
+ * Results are the same as the reference XXH64 (seed 0) on little-endian machines,
+ *  so they can be compared across builds and platforms -- as long as what is hashed
+ *  is laid out the same (add fields, not whole structs with padding or library-specific layout).
+ */
+
+#include <cstdint>
+#include <cstring>
+
+struct Checksum {
+	Checksum() { }
+
+	//hash 'size' bytes starting at 'data':
+	void add(void const *data, size_t size) {
+		uint8_t const *at = reinterpret_cast< uint8_t const * >(data);
+		total += size;
+
+		//top off a partial stripe first:
+		if (buffered) {
+			size_t take = (size < 32 - buffered ? size : 32 - buffered);
+			std::memcpy(buffer + buffered, at, take);
+			buffered += uint32_t(take);
+			at += take;
+			size -= take;
+			if (buffered < 32) return;
+			stripe(buffer);
+			buffered = 0;
+		}
+		//whole stripes straight from the input:
+		while (size >= 32) {
+			stripe(at);
+			at += 32;
+			size -= 32;
+		}
+		//keep the rest for later:
+		std::memcpy(buffer, at, size);
+		buffered = uint32_t(size);
+	}
+
+	//helper for adding one plain value (an int, a float, a glm::vec2, ...):
+	template< typename T >
+	void add_value(T const &value) {
+		add(&value, sizeof(value));
+	}
+
+	//the hash of everything added so far (doesn't change the state, so more can be added after):
+	uint64_t digest() const {
+		uint64_t h;
+		if (total >= 32) {
+			h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+			for (uint32_t i = 0; i < 4; ++i) {
+				h ^= round(0, v[i]);
+				h = h * Prime1 + Prime4;
+			}
+		} else {
+			h = Prime5;
+		}
+		h += total;
+
+		uint8_t const *at = buffer;
+		uint8_t const *end = buffer + buffered;
+		for (; at + 8 <= end; at += 8) {
+			h ^= round(0, read64(at));
+			h = rotl(h, 27) * Prime1 + Prime4;
+		}
+		if (at + 4 <= end) {
+			h ^= uint64_t(read32(at)) * Prime1;
+			h = rotl(h, 23) * Prime2 + Prime3;
+			at += 4;
+		}
+		for (; at < end; ++at) {
+			h ^= uint64_t(*at) * Prime5;
+			h = rotl(h, 11) * Prime1;
+		}
+
+		h ^= h >> 33;
+		h *= Prime2;
+		h ^= h >> 29;
+		h *= Prime3;
+		h ^= h >> 32;
+		return h;
+	}
+
+	//one-shot version:
+	static uint64_t of(void const *data, size_t size) {
+		Checksum checksum;
+		checksum.add(data, size);
+		return checksum.digest();
+	}
+
+	//----- internals -----
+	static constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ULL;
+	static constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL;
+	static constexpr uint64_t Prime3 = 0x165667B19E3779F9ULL;
+	static constexpr uint64_t Prime4 = 0x85EBCA77C2B2AE63ULL;
+	static constexpr uint64_t Prime5 = 0x27D4EB2F165667C5ULL;
+
+	uint64_t v[4] = { Prime1 + Prime2, Prime2, 0, 0 - Prime1 }; //(the four lanes)
+	uint64_t total = 0; //bytes added
+	uint8_t buffer[32]; //partial stripe
+	uint32_t buffered = 0;
+
+	static uint64_t rotl(uint64_t x, uint32_t r) { return (x << r) | (x >> (64 - r)); }
+	static uint64_t round(uint64_t acc, uint64_t input) {
+		acc += input * Prime2;
+		acc = rotl(acc, 31);
+		return acc * Prime1;
+	}
+	static uint64_t read64(uint8_t const *at) { uint64_t x; std::memcpy(&x, at, 8); return x; }
+	static uint32_t read32(uint8_t const *at) { uint32_t x; std::memcpy(&x, at, 4); return x; }
+	void stripe(uint8_t const *at) {
+		v[0] = round(v[0], read64(at));
+		v[1] = round(v[1], read64(at + 8));
+		v[2] = round(v[2], read64(at + 16));
+		v[3] = round(v[3], read64(at + 24));
+	}
+};
@@ -0,0 +1,199 @@
+#include "GameState.hpp"
+
+#include "swept_collide.hpp"
+#include "Checksum.hpp"
+#include "assets_embedded.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+std::vector< PPU466::Tile > GameState::load_tiles() {
+	return std::vector< PPU466::Tile >(assets::tiles.begin(), assets::tiles.end());
+}
+
+GameState::GameState(std::vector< PPU466::Tile > const &tiles) : GameState(tiles, Tuning(), std::mt19937::default_seed) {
+}
+
+GameState::GameState(std::vector< PPU466::Tile > const &tiles, Tuning const &tuning_, uint32_t seed_) : tuning(tuning_), seed(seed_), rng(seed_) {
+	time_remain = tuning.session_length;
+
+	auto mask = [&tiles](assets::Sprite const &resource) -> uint64_t {
+		if (resource.index() >= tiles.size()) {
+			throw std::runtime_error("Tile table is missing tile " + std::to_string(resource.index()) + ".");
+		}
+		return PPU466::flip_opacity_mask(tiles[resource.index()].opacity_mask(), resource.flip);
+	};
+	boomerang_left_mask = mask(assets::sprites::boomerang_left);
+	boomerang_right_mask = mask(assets::sprites::boomerang_right);
+	fish_mask = mask(assets::sprites::fish);
+	whale_mask = mask(assets::sprites::whale);
+	bomb_mask = mask(assets::sprites::bomb);
+
+	auto init_targets = [](Targets &targets, uint8_t *count) {
+		*count = uint8_t(std::min< uint32_t >(*count, Targets::Capacity));
+		targets.count = *count;
+		for (uint32_t i = 0; i < Targets::Capacity; ++i) {
+			targets.at[i] = glm::vec2(0.0f, 240.0f);
+			targets.prev_at[i] = glm::vec2(0.0f, 240.0f);
+			targets.velocity[i] = glm::vec2(0.0f, 0.0f);
+			targets.active[i] = false;
+		}
+	};
+	init_targets(fish, &tuning.num_fish);
+	init_targets(whale, &tuning.num_whale);
+	init_targets(bomb, &tuning.num_bomb);
+}
+
+void GameState::update_target(Targets &targets, float elapsed){
+	auto &at = targets.at;
+	auto &prev_at = targets.prev_at;
+	auto &velocity = targets.velocity;
+	auto &active = targets.active;
+	for (uint32_t i=0; i<targets.count; i++){
+		prev_at[i] = at[i];
+		if (active[i]){
+			velocity[i].y -= tuning.gravity * elapsed;
+			at[i].x += velocity[i].x * elapsed;
+			at[i].y += velocity[i].y * elapsed;
+			if (at[i].y < 0.0f || at[i].x < 0.0f || at[i].x > 256.0f){
+				active[i] = false;
+				at[i].y = 240;
+			}
+		} else {
+			if ((rng()/float(rng.max())) < tuning.spawn_chance){
+				active[i] = true;
+			 	at[i].y = 0.0f;
+				at[i].x = (rng()/float(rng.max())) * 256.0f;
+				velocity[i].x = (rng()/float(rng.max()))*40.0f - 20.0f;
+				velocity[i].y = 80.0f;
+				prev_at[i] = at[i]; //just appeared, so didn't sweep from anywhere
+			}
+		}
+	}
+}
+
+//check if the boomerang (tile mask 'p_mask', moving p0 -> p1) touched any of the targets (tile mask 'target_mask', moving prev_at -> at) during the step:
+// the whole path of both is tested, so fast boomerangs can't skip over targets even with long steps.
+void check_hit(GameState::Targets &targets, uint64_t target_mask, glm::vec2 p0, glm::vec2 p1, uint64_t p_mask, int pts, int& score){
+	auto &at = targets.at;
+	auto const &prev_at = targets.prev_at;
+	auto &active = targets.active;
+	for(uint32_t i = 0; i<targets.count;i++){
+		if(at[i].y == 240){
+			continue;
+		}
+		bool hit = swept_tiles_overlap(p_mask, p0, p1, target_mask, prev_at[i], at[i]);
+		if(hit){
+			active[i] = false;
+			at[i].y = 240;
+			score += pts;
+			score = std::max(score, 0);
+		}
+	}
+}
+
+bool GameState::boomerang_faces_left(uint32_t index) const {
+	return boomerangs.state[index] == BoomerangPool::BoomerangState::FLYING && boomerangs.vec_x[index] < 0.0;
+}
+
+void GameState::handle_input(InputEvent evt) {
+	if (evt == InputEvent::SpaceDown) {
+		space_key.downs += 1;
+		space_key.pressed = true;
+	} else if (evt == InputEvent::SpaceUp) {
+		space_key.pressed = false;
+	}
+}
+
+void GameState::update(float elapsed) {
+	if (game_stop){
+		return;
+	}
+	time_remain -= elapsed;
+	if (time_remain <=0){
+		game_stop = true;
+	}
+	//reset button press counters:
+	space_key.downs = 0;
+
+	if (space_key.pressed) {
+		if (held_boomerang == BoomerangPool::None && boomerangs.active_count() < boomerang_limit) {
+			held_boomerang = boomerangs.allocate(boomerang_hand_at);
+		}
+	} else {
+		if (held_boomerang != BoomerangPool::None) {
+			boomerangs.launch(held_boomerang);
+			held_boomerang = BoomerangPool::None;
+		}
+	}
+
+	boomerangs.update(elapsed);
+
+	update_target(fish, elapsed);
+	update_target(whale, elapsed);
+	update_target(bomb, elapsed);
+
+	//check if boomrang hit target
+	// (pixel-exact, using the opaque pixels of the tiles that things are drawn with)
+	auto check_boomerang_hit = [&](glm::vec2 const &at0, glm::vec2 const &at1, bool faces_left) {
+		uint64_t boomerang_mask = (faces_left ? boomerang_left_mask : boomerang_right_mask);
+		check_hit(fish, fish_mask, at0, at1, boomerang_mask, tuning.fish_points,score);
+		check_hit(whale, whale_mask, at0, at1, boomerang_mask, tuning.whale_points,score);
+		check_hit(bomb, bomb_mask, at0, at1, boomerang_mask, tuning.bomb_points,score);
+	};
+	if (boomerangs.active_count() == 0) {
+		//the idle boomerang in the player's hand still catches things:
+		check_boomerang_hit(boomerang_hand_at, boomerang_hand_at, false);
+	} else {
+		for (uint32_t i = 0; i < BoomerangPool::Capacity; ++i) {
+			if (boomerangs.state[i] == BoomerangPool::BoomerangState::INACTIVE) continue;
+			check_boomerang_hit(boomerangs.prev_at[i], boomerangs.at[i], boomerang_faces_left(i));
+		}
+	}
+
+}
+
+uint64_t GameState::checksum() const {
+	//field by field, so the result doesn't depend on padding or on the standard library's layout:
+	Checksum checksum;
+	auto add_targets = [&checksum](Targets const &targets) {
+		for (uint32_t i = 0; i < targets.count; ++i) {
+			checksum.add_value(targets.at[i]);
+			checksum.add_value(targets.velocity[i]);
+			checksum.add_value(uint8_t(targets.active[i]));
+		}
+	};
+
+	checksum.add_value(score);
+	checksum.add_value(time_remain);
+	uint8_t flags[3] = { uint8_t(game_stop), space_key.downs, space_key.pressed };
+	checksum.add(flags, sizeof(flags));
+
+	//(the generator's internal layout differs between standard libraries, so it is
+	// fingerprinted by its next state_size (624) outputs instead -- tempering is invertible,
+	// so those pin down its whole state, and generators that would diverge later hash differently now)
+	std::mt19937 peek = rng;
+	std::array< uint32_t, std::mt19937::state_size > upcoming;
+	for (auto &word : upcoming) word = uint32_t(peek());
+	checksum.add(upcoming.data(), sizeof(upcoming));
+
+	checksum.add_value(held_boomerang);
+	for (uint32_t i = 0; i < BoomerangPool::Capacity; ++i) {
+		if (boomerangs.state[i] == BoomerangPool::BoomerangState::INACTIVE) continue;
+		checksum.add_value(i);
+		checksum.add_value(boomerangs.at[i]);
+		checksum.add_value(boomerangs.vec_x[i]);
+		checksum.add_value(boomerangs.state[i]);
+		checksum.add_value(boomerangs.holding_time[i]);
+	}
+
+	add_targets(fish);
+	add_targets(whale);
+	add_targets(bomb);
+
+	return checksum.digest();
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+/*
+ * GameState -- everything Akuaman Simulator needs to simulate a session:
+ *  score, time, input, boomerangs, and targets, plus the update logic.
+ *
+ * GameState does not touch the PPU, OpenGL, or SDL, so it can run headless
+ *  (e.g., in sim_bench); PlayMode owns a GameState and presents it through a PPU466.
+ */
+
+#include "PPU466.hpp"
+#include "BoomerangPool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+struct GameState {
+	//Tuning: the knobs that decide how a session plays out:
+	struct Tuning {
+		uint8_t num_fish = 10;
+		uint8_t num_whale = 2;
+		uint8_t num_bomb = 1;
+		float gravity = 20.0f; //pixels / second^2, pulls targets down
+		float spawn_chance = 0.01f; //chance per update that an inactive target appears
+		int fish_points = 1;
+		int whale_points = 10;
+		int bomb_points = -10;
+		double session_length = 60.0; //seconds
+	};
+
+	//'tiles' is the tile table (as from load_tiles()):
+	// only the opacity masks of the boomerang and target tiles are kept, for collision.
+	//'seed' seeds this session's random number generator.
+	GameState(std::vector< PPU466::Tile > const &tiles, Tuning const &tuning, uint32_t seed);
+	//(default tuning and seed -- the usual game:)
+	GameState(std::vector< PPU466::Tile > const &tiles);
+
+	//the tile table the game is built with (assets::tiles, from assets_embedded.hpp -- the same table the
+	// handles GameState uses for its masks index into, so the game and the headless tools agree):
+	static std::vector< PPU466::Tile > load_tiles();
+
+	//input events:
+	// (PlayMode turns SDL events into these; replays record and re-apply them)
+	enum class InputEvent : uint8_t {
+		SpaceDown = 0,
+		SpaceUp = 1,
+	};
+	void handle_input(InputEvent evt);
+
+	//advance the simulation by 'elapsed' seconds:
+	void update(float elapsed);
+
+	//hash of the whole simulation state (including the generator state):
+	// two sessions with the same checksum after every update have (almost certainly) behaved identically.
+	// (portable: builds on different platforms agree as long as they simulate identically)
+	uint64_t checksum() const;
+
+	//targets of one kind (fish, whales, or bombs):
+	// (fixed capacity, so GameState is plain data that can be copied byte-for-byte -- see RewindBuffer)
+	struct Targets {
+		enum : uint32_t { Capacity = 64 };
+		uint32_t count = 0; //slots [0, count) are in use (count comes from the tuning)
+		std::array< glm::vec2, Capacity > at;
+		std::array< glm::vec2, Capacity > prev_at; //position at the start of the most recent update()
+		std::array< glm::vec2, Capacity > velocity;
+		std::array< bool, Capacity > active;
+	};
+
+	void update_target(Targets &targets, float elapsed);
+
+	//which way boomerang 'index' from the pool is drawn (depends on flight direction):
+	// (the left and right images may share a tile, so this is not a tile index)
+	bool boomerang_faces_left(uint32_t index) const;
+
+	//----- game state -----
+	Tuning tuning;
+
+	// time and score
+	int score = 0;
+	double time_remain = 60;
+	bool game_stop = false;
+
+	//every random choice in the session comes from here:
+	// (each GameState has its own, so sessions are independent and repeatable from their seed)
+	uint32_t seed;
+	std::mt19937 rng;
+
+	//input tracking:
+	struct Button {
+		uint8_t downs = 0;
+		uint8_t pressed = 0;
+	} space_key;
+
+	//boomerangs:
+	// every boomerang in play (held or flying) lives in the pool:
+	BoomerangPool boomerangs;
+	// the boomerang the player is currently holding (BoomerangPool::None if not holding one):
+	uint32_t held_boomerang = BoomerangPool::None;
+	// the player may only start holding a new boomerang while fewer than this many are in play:
+	// (1 for normal play; load tests can raise it to throw many at once)
+	uint32_t boomerang_limit = 1;
+	// where boomerangs are held (and where the idle boomerang sits when none are in play):
+	glm::vec2 boomerang_hand_at = glm::vec2(0.0f, 128.0f);
+
+	//targets:
+	// (tuning.num_fish, .num_whale, and .num_bomb are clamped to Targets::Capacity)
+	Targets fish;
+	Targets whale;
+	Targets bomb;
+
+	//----- collision shapes -----
+	// opacity masks (see PPU466::Tile::opacity_mask()) of the tiles things are drawn with:
+	uint64_t boomerang_left_mask = 0;
+	uint64_t boomerang_right_mask = 0;
+	uint64_t fish_mask = 0;
+	uint64_t whale_mask = 0;
+	uint64_t bomb_mask = 0;
+};
+
+static_assert(std::is_trivially_copyable< GameState >::value, "GameState is plain data");
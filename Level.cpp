@@ -0,0 +1,42 @@
+#include "Level.hpp"
+
+#include "read_write_chunk.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <stdexcept>
+
+void Levels::load(std::string const &filename) {
+	std::ifstream from(filename, std::ios::binary);
+	if (!from) {
+		throw std::runtime_error("Failed to open levels '" + filename + "'.");
+	}
+	read_chunk(from, "lvl0", &levels);
+	read_chunk(from, "nmt0", &nametable);
+
+	for (auto const &level : levels) {
+		if (uint64_t(level.first_entry) + uint64_t(level.width) * level.height > nametable.size()) {
+			throw std::runtime_error("Level in '" + filename + "' refers to entries past the end of its nametable.");
+		}
+	}
+}
+
+void Levels::copy(uint32_t which, glm::uvec2 const &from, glm::uvec2 const &size, PPU466 *ppu) const {
+	assert(ppu);
+	Level const &level = levels.at(which);
+	//clip the window to the level:
+	uint32_t x_end = uint32_t(std::min< uint64_t >(uint64_t(from.x) + size.x, level.width));
+	uint32_t y_end = uint32_t(std::min< uint64_t >(uint64_t(from.y) + size.y, level.height));
+	for (uint32_t x = from.x; x < x_end; ++x) {
+		uint16_t const *entries = column(which, x);
+		//each column goes in as (at most) two runs, split where it wraps from the top of the background to the bottom:
+		uint32_t y = from.y;
+		while (y < y_end) {
+			uint32_t row = y % PPU466::BackgroundHeight;
+			uint32_t count = std::min(y_end - y, PPU466::BackgroundHeight - row);
+			ppu->set_background_column(x % PPU466::BackgroundWidth, row, count, entries + y);
+			y += count;
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+/*
+ * Levels -- background maps made in an image editor.
+ *
+ * The asset converter slices each level PNG (given with --levels) into tiles, sharing the sprites'
+ *  tiles and palettes, and stores it as a nametable: one PPU466::background entry per tile, column
+ *  by column (bottom to top within a column), so a map wider than the background can be read a
+ *  column at a time as it scrolls in.
+ * assets_embedded.hpp gives each level a typed handle with its index and size in tiles
+ *  (assets::levels::sea is an assets::Level: .index, .width, .height); the older assets_res.h
+ *  macros (NAME_LEVEL_IDX, NAME_LEVEL_WIDTH, NAME_LEVEL_HEIGHT) say the same thing.
+ *
+ * Example:
+ *   Levels levels;
+ *   levels.load(data_path("assets/levels.chunk"));
+ *   levels.copy(assets::levels::sea.index, glm::uvec2(0), glm::uvec2(PPU466::BackgroundWidth, PPU466::BackgroundHeight), &ppu);
+ */
+
+#include "PPU466.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Levels {
+	struct Level {
+		uint32_t width = 0; //size in tiles
+		uint32_t height = 0;
+		uint32_t first_entry = 0; //the level's entries are nametable[first_entry, first_entry + width * height)
+	};
+	static_assert(sizeof(Level) == 12, "Level is packed");
+
+	std::vector< Level > levels;
+	std::vector< uint16_t > nametable; //every level's entries, one after another
+
+	//read the "lvl0" (levels) and "nmt0" (nametable) chunks written by the asset converter:
+	// (throws on error)
+	void load(std::string const &filename);
+
+	//the 'height' entries of column x of level 'which', bottom to top:
+	uint16_t const *column(uint32_t which, uint32_t x) const {
+		Level const &level = levels.at(which);
+		return nametable.data() + level.first_entry + x * level.height;
+	}
+
+	//copy the level's tiles [from, from + size) into ppu->background, wrapping around the way the
+	// background does (level tile (x,y) goes to background tile (x % 64, y % 60)), so a window of the
+	// level can be put under any background_position; parts of the window outside the level are skipped:
+	void copy(uint32_t which, glm::uvec2 const &from, glm::uvec2 const &size, PPU466 *ppu) const;
+};
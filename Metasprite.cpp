@@ -0,0 +1,54 @@
+#include "Metasprite.hpp"
+
+#include "read_write_chunk.hpp"
+
+#include <cassert>
+#include <fstream>
+#include <stdexcept>
+
+void Metasprites::load(std::string const &filename) {
+	std::ifstream from(filename, std::ios::binary);
+	if (!from) {
+		throw std::runtime_error("Failed to open metasprites '" + filename + "'.");
+	}
+	read_chunk(from, "msp0", &metasprites);
+	read_chunk(from, "mpt0", &parts);
+
+	for (auto const &metasprite : metasprites) {
+		if (uint32_t(metasprite.first_part) + metasprite.part_count > parts.size()) {
+			throw std::runtime_error("Metasprite in '" + filename + "' refers to parts past the end of its part list.");
+		}
+	}
+}
+
+uint32_t Metasprites::request(uint32_t which, glm::ivec2 const &at, uint8_t attributes, SpriteAllocator *allocator, uint8_t priority) const {
+	assert(allocator);
+	if (which >= metasprites.size()) {
+		throw std::runtime_error("No metasprite " + std::to_string(which) + ".");
+	}
+	Metasprite const &metasprite = metasprites[which];
+
+	uint8_t flip = attributes & (PPU466::FlipX | PPU466::FlipY);
+	uint8_t behind = attributes & 0x80;
+
+	uint32_t requested = 0;
+	for (uint32_t p = 0; p < metasprite.part_count; ++p) {
+		Part const &part = parts[metasprite.first_part + p];
+		//mirroring the metasprite mirrors where each part goes, as well as each part's tile:
+		glm::ivec2 offset = glm::ivec2(part.x, part.y);
+		if (flip & PPU466::FlipX) offset.x = int32_t(metasprite.width) - 8 - offset.x;
+		if (flip & PPU466::FlipY) offset.y = int32_t(metasprite.height) - 8 - offset.y;
+		glm::ivec2 pos = at + offset;
+
+		if (pos.x < 0 || pos.x > 255 || pos.y < 0 || pos.y >= int32_t(PPU466::ScreenHeight)) continue; //(off-screen)
+
+		PPU466::Sprite sprite;
+		sprite.x = uint8_t(pos.x);
+		sprite.y = uint8_t(pos.y);
+		sprite.index = part.index;
+		sprite.attributes = uint8_t((part.attributes ^ flip) | behind);
+		allocator->request(sprite, priority);
+		requested += 1;
+	}
+	return requested;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+/*
+ * Metasprites -- pictures bigger than one tile, drawn with several PPU466 sprites.
+ *
+ * The asset converter slices sprite images bigger than 8x8 into tiles (sharing repeated ones)
+ *  and writes, for each picture, the tile and attributes of every 8x8 part and where it goes.
+ * A sheet of same-sized frames -- named like 'walk@16x16.png' -- becomes one metasprite per frame.
+ * assets_embedded.hpp gives each picture a typed handle (assets::metasprites::walk is an
+ *  assets::Metasprite; frame i of a sheet is .frame(i), with .frames frames); the older
+ *  assets_res.h macros say the same thing (NAME_METASPRITE_IDX + i, NAME_FRAMES).
+ *
+ * Example:
+ *   Metasprites metasprites;
+ *   metasprites.load(data_path("assets/metasprites.chunk"));
+ *   sprites.begin(); //(the SpriteAllocator that fills ppu.sprites each frame)
+ *   metasprites.request(assets::metasprites::whale_big.first, glm::ivec2(100, 50), 0, &sprites, SpriteAllocator::Normal);
+ *   sprites.finish(&ppu.sprites);
+ */
+
+#include "PPU466.hpp"
+#include "SpriteAllocator.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Metasprites {
+	//One 8x8 part of a metasprite:
+	struct Part {
+		uint8_t x = 0; //offset of the part's lower-left from the metasprite's lower-left, in pixels
+		uint8_t y = 0;
+		uint8_t index = 0; //tile table index
+		uint8_t attributes = 0; //palette and flip bits, as in PPU466::Sprite
+	};
+	static_assert(sizeof(Part) == 4, "Part is packed");
+
+	//A metasprite is a run of parts:
+	struct Metasprite {
+		uint16_t first_part = 0;
+		uint16_t part_count = 0; //(fully transparent parts are left out)
+		uint16_t width = 0; //size in pixels (a multiple of 8)
+		uint16_t height = 0;
+	};
+	static_assert(sizeof(Metasprite) == 8, "Metasprite is packed");
+
+	std::vector< Part > parts;
+	std::vector< Metasprite > metasprites;
+
+	//read the "msp0" (metasprites) and "mpt0" (parts) chunks written by the asset converter:
+	// (throws on error)
+	void load(std::string const &filename);
+
+	//request metasprite 'which', with its lower-left at 'at', from 'allocator' (one sprite per part, all at 'priority'):
+	// - FlipX / FlipY in 'attributes' mirror the whole metasprite; the priority bit (bit 7) applies to every part
+	// - parts that would hang off the screen aren't requested (the PPU can't show them partly)
+	//returns the number of parts requested:
+	uint32_t request(uint32_t which, glm::ivec2 const &at, uint8_t attributes, SpriteAllocator *allocator, uint8_t priority) const;
+};
@@ -20,6 +20,13 @@ struct Mode : std::enable_shared_from_this< Mode > {
 	//draw is called after update:
 	virtual void draw(glm::uvec2 const &drawable_size) = 0;
 
+	//tick_alpha is set by the main loop before each call to draw:
+	// when the main loop runs fixed-size update steps, the frame being drawn usually falls between two steps;
+	// tick_alpha (in [0,1)) is how far past the most recent update the frame is, as a fraction of a step,
+	// so draw can interpolate between the previous and current state.
+	// (when update is called with variable-size steps, tick_alpha is always 1.0 -- draw the current state.)
+	float tick_alpha = 1.0f;
+
 	//Mode::current is the Mode to which events are dispatched.
 	// use 'set_current' to change the current Mode (e.g., to switch to a menu)
 	static std::shared_ptr< Mode > current;
@@ -8,6 +8,9 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <vector>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 
 //In order to implement the PPU466 on modern graphics hardware, a fancy, special purpose tile-drawing shader is used:
 struct PPUTileProgram {
@@ -29,8 +32,27 @@ struct PPUTileProgram {
 	//TEXTURE1 - the palette table (as a 4x8 RGBA8 texture)
 };
 
+//The background layer is drawn by a second shader, which looks up the background for every screen pixel:
+// (so each scanline can have its own background position at no extra cost; see PPU466::scanline_scroll)
+struct PPUBackgroundProgram {
+	PPUBackgroundProgram();
+	~PPUBackgroundProgram();
+
+	GLuint program = 0;
+
+	//Attributes:
+	// (none -- the vertex shader makes a screen-covering quad from gl_VertexID)
+
+	//Textures bindings:
+	//TEXTURE0 - the tile table (as a 128x128 R8UI texture)
+	//TEXTURE1 - the palette table (as a 4x8 RGBA8 texture)
+	//TEXTURE2 - the background (as a 64x60 R16UI texture)
+	//TEXTURE3 - the background position of each scanline (as a 240x1 RG16I texture)
+};
+
 //Initialize tile program and associated buffers:
 Load< PPUTileProgram > tile_program(LoadTagEarly); //will 'new PPUTileProgram()' by default
+Load< PPUBackgroundProgram > background_program(LoadTagEarly);
 
 //PPU data is streamed to the GPU (read: uploaded 'just in time') using a few buffers:
 struct PPUDataStream {
@@ -54,11 +76,20 @@ struct PPUDataStream {
 	//vertex array object that maps tile program attributes to vertex storage:
 	GLuint vertex_buffer_for_tile_program = 0;
 
+	//(empty) vertex array object for the background program, which has no attributes:
+	GLuint empty_vertex_array = 0;
+
 	//texture object that will store tile table:
 	GLuint tile_tex = 0;
 
 	//texture object that will store palette table:
 	GLuint palette_tex = 0;
+
+	//texture object that will store the background:
+	GLuint background_tex = 0;
+
+	//texture object that will store the background position of each scanline:
+	GLuint scroll_tex = 0;
 };
 
 Load< PPUDataStream > data_stream(LoadTagDefault);
@@ -84,6 +115,111 @@ PPU466::PPU466() {
 			| (i % palette_table.size()) //cycle through all tiles
 		);
 	}
+
+	scanline_scroll.fill(glm::i16vec2(0));
+}
+
+//tile banks with pre-unpacked textures (see PPU466::register_tile_texture):
+struct RegisteredTileTexture {
+	std::array< PPU466::Tile, 16 * 16 > tiles;
+	std::vector< uint8_t > texels;
+};
+static std::vector< RegisteredTileTexture > &registered_tile_textures() {
+	static std::vector< RegisteredTileTexture > registered;
+	return registered;
+}
+
+void PPU466::register_tile_texture(std::array< Tile, 16 * 16 > const &tiles, std::vector< uint8_t > const &texels) {
+	if (texels.size() != TileTextureSize * TileTextureSize) {
+		throw std::runtime_error("Tile texture should have " + std::to_string(TileTextureSize * TileTextureSize) + " texels, not " + std::to_string(texels.size()) + ".");
+	}
+	for (auto &registered : registered_tile_textures()) {
+		if (std::memcmp(&registered.tiles, &tiles, sizeof(tiles)) == 0) {
+			registered.texels = texels;
+			return;
+		}
+	}
+	registered_tile_textures().emplace_back(RegisteredTileTexture{tiles, texels});
+}
+
+void PPU466::set_background_rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint16_t const *values) {
+	assert(x + width <= BackgroundWidth && y + height <= BackgroundHeight && "rectangle is inside the background");
+	assert(values || width * height == 0);
+	for (uint32_t row = 0; row < height; ++row) {
+		std::copy(values + width * row, values + width * (row + 1), background.begin() + (x + BackgroundWidth * (y + row)));
+	}
+	mark_background_dirty(y, y + height);
+}
+
+void PPU466::fill_background_rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint16_t value) {
+	assert(x + width <= BackgroundWidth && y + height <= BackgroundHeight && "rectangle is inside the background");
+	for (uint32_t row = 0; row < height; ++row) {
+		auto begin = background.begin() + (x + BackgroundWidth * (y + row));
+		std::fill(begin, begin + width, value);
+	}
+	mark_background_dirty(y, y + height);
+}
+
+void PPU466::set_background_column(uint32_t x, uint32_t y, uint32_t height, uint16_t const *values) {
+	assert(x < BackgroundWidth && y + height <= BackgroundHeight && "column is inside the background");
+	assert(values || height == 0);
+	for (uint32_t row = 0; row < height; ++row) {
+		background[x + BackgroundWidth * (y + row)] = values[row];
+	}
+	if (height) background_dirty_columns |= (1ULL << x);
+}
+
+//number of bits set in a 64-bit value:
+static uint32_t popcount64(uint64_t x) {
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return uint32_t((x * 0x0101010101010101ULL) >> 56);
+}
+
+void PPU466::evaluate_scanlines(uint32_t limit, ScanlineEvaluation *evaluation_) const {
+	assert(evaluation_);
+	auto &evaluation = *evaluation_;
+
+	//one pass over the sprites, marking the (up to) eight scanlines each covers:
+	evaluation.covering.fill(0);
+	for (uint32_t i = 0; i < sprites.size(); ++i) {
+		uint32_t end = std::min< uint32_t >(sprites[i].y + 8, ScreenHeight);
+		for (uint32_t y = sprites[i].y; y < end; ++y) {
+			evaluation.covering[y] |= (1ULL << i);
+		}
+	}
+
+	//one pass over the scanlines, keeping the highest-numbered 'limit' sprites on each:
+	// (later sprites draw on top -- so SpriteAllocator puts the most important ones last -- so the front-most
+	//  sprites are the ones that survive, like the NES keeping the sprites that come first in OAM)
+	evaluation.overflow_scanlines = 0;
+	evaluation.busiest_scanline = 0;
+	evaluation.busiest_count = 0;
+	for (uint32_t y = 0; y < ScreenHeight; ++y) {
+		uint64_t covering = evaluation.covering[y];
+		uint32_t count = popcount64(covering);
+		if (count > evaluation.busiest_count) {
+			evaluation.busiest_count = count;
+			evaluation.busiest_scanline = y;
+		}
+		if (limit == 0 || count <= limit) {
+			evaluation.shown[y] = covering;
+		} else {
+			evaluation.overflow_scanlines += 1;
+			uint64_t shown = 0;
+			for (uint32_t n = 0; n < limit; ++n) {
+				//smear the highest set bit down through all the lower ones, then keep just it:
+				uint64_t below = covering;
+				below |= below >> 1; below |= below >> 2; below |= below >> 4;
+				below |= below >> 8; below |= below >> 16; below |= below >> 32;
+				uint64_t highest = below ^ (below >> 1);
+				shown |= highest;
+				covering ^= highest;
+			}
+			evaluation.shown[y] = shown;
+		}
+	}
 }
 
 void PPU466::draw(glm::uvec2 const &drawable_size) const {
@@ -120,116 +256,190 @@ void PPU466::draw(glm::uvec2 const &drawable_size) const {
 		glViewport(lower_left.x, lower_left.y, scale * ScreenWidth, scale * ScreenHeight);
 	}
 
-	//build triangle strip representing background and sprites:
+	//build triangle strip representing sprites:
+	// (the background is drawn separately, between the 'behind' and 'in front' sprites)
 
-	constexpr uint32_t TristripSize = uint32_t(6 * (BackgroundWidth * BackgroundHeight + decltype(sprites)().size()));
+	//(sprites cut by the scanline limit may take up to four quads -- one per run of rows still shown)
+	constexpr uint32_t TristripSize = uint32_t(6 * 4 * decltype(sprites)().size());
 	std::vector< PPUDataStream::Vertex > triangle_strip;
 	triangle_strip.reserve(TristripSize);
 
-	//helper to put a single tile somewhere on the screen:
-	auto draw_tile = [&triangle_strip](glm::ivec2 const &lower_left, uint8_t tile_index, uint8_t palette_index){
+	//helper to put rows [row_begin,row_end) of a (possibly flipped) tile somewhere on the screen:
+	auto draw_tile_rows = [&triangle_strip](glm::ivec2 const &lower_left, uint8_t tile_index, uint8_t palette_index, uint8_t flip, int32_t row_begin, int32_t row_end){
 		//convert tile index to lower-left pixel coordinate in tile image:
 		glm::ivec2 tile_coord = glm::ivec2((tile_index % 16)*8, (tile_index / 16)*8);
 
+		//flipping just swaps which edges of the tile the texture coordinates come from:
+		int32_t left = (flip & FlipX ? 8 : 0);
+		int32_t right = 8 - left;
+		int32_t bottom = (flip & FlipY ? 8 - row_begin : row_begin);
+		int32_t top = (flip & FlipY ? 8 - row_end : row_end);
+
 		//build a quad as a (very short) triangle strip that starts and ends with degenerate triangles:
-		triangle_strip.emplace_back(glm::ivec2(lower_left.x+0, lower_left.y+0), glm::ivec2(tile_coord.x+0, tile_coord.y+0), palette_index);
+		triangle_strip.emplace_back(glm::ivec2(lower_left.x+0, lower_left.y+row_begin), glm::ivec2(tile_coord.x+left, tile_coord.y+bottom), palette_index);
 		triangle_strip.emplace_back(triangle_strip.back());
-		triangle_strip.emplace_back(glm::ivec2(lower_left.x+0, lower_left.y+8), glm::ivec2(tile_coord.x+0, tile_coord.y+8), palette_index);
-		triangle_strip.emplace_back(glm::ivec2(lower_left.x+8, lower_left.y+0), glm::ivec2(tile_coord.x+8, tile_coord.y+0), palette_index);
-		triangle_strip.emplace_back(glm::ivec2(lower_left.x+8, lower_left.y+8), glm::ivec2(tile_coord.x+8, tile_coord.y+8), palette_index);
+		triangle_strip.emplace_back(glm::ivec2(lower_left.x+0, lower_left.y+row_end), glm::ivec2(tile_coord.x+left, tile_coord.y+top), palette_index);
+		triangle_strip.emplace_back(glm::ivec2(lower_left.x+8, lower_left.y+row_begin), glm::ivec2(tile_coord.x+right, tile_coord.y+bottom), palette_index);
+		triangle_strip.emplace_back(glm::ivec2(lower_left.x+8, lower_left.y+row_end), glm::ivec2(tile_coord.x+right, tile_coord.y+top), palette_index);
 		triangle_strip.emplace_back(triangle_strip.back());
 	};
 
-	//helper to draw the sprite list (used because we need to draw the 'behind' sprites, then the background, then the 'front' sprites:
-	auto draw_sprites = [this,&draw_tile](uint8_t priority) {
-		for (auto const &sprite : sprites) {
-			if ((sprite.attributes & 0x80) != priority) continue;
-			draw_tile(
-				glm::ivec2(sprite.x, sprite.y),
-				sprite.index,
-				sprite.attributes & 0x07 //just the palette index part
-			);
-		}
+	//helper to put a single tile somewhere on the screen:
+	auto draw_tile = [&draw_tile_rows](glm::ivec2 const &lower_left, uint8_t tile_index, uint8_t palette_index, uint8_t flip){
+		draw_tile_rows(lower_left, tile_index, palette_index, flip, 0, 8);
 	};
 
-	draw_sprites(0x80); //draw sprites with priority == 1 ('behind' sprites)
+	//with a scanline limit, figure out which rows of which sprites get drawn:
+	static ScanlineEvaluation evaluation; //(static to keep ~4k off the stack; draw() isn't re-entrant anyway)
+	if (sprites_per_scanline > 0) {
+		evaluate_scanlines(sprites_per_scanline, &evaluation);
+		sprite_overflow = (evaluation.overflow_scanlines > 0);
+	} else {
+		sprite_overflow = false;
+	}
 
-	{ //draw the background:
-		//To simulate the 'infinite tiling' behavior this code draws the background as four screen-sized chunks,
-		// each of which is drawn at an offset that causes it to overlap the screen.
-
-		static_assert(BackgroundWidth * 8 == ScreenWidth * 2, "Background should be exactly twice the screen width.");
-		static_assert(BackgroundHeight * 8 == ScreenHeight * 2, "Background should be exactly twice the screen height.");
-
-		for (int32_t chunk_y : {0, int32_t(ScreenHeight)}) {
-			for (int32_t chunk_x : {0, int32_t(ScreenWidth)}) {
-				//position of the lower-left corner of the chunk:
-				glm::ivec2 pos = glm::ivec2(chunk_x, chunk_y) + background_position;
-
-				constexpr int32_t BackgroundWidthPixels = int32_t(BackgroundWidth) * 8;
-				constexpr int32_t BackgroundHeightPixels = int32_t(BackgroundHeight) * 8;
-
-				//reduce to (-BackgroundWidthPixels,0] x (-BackgroundHeightPixels,0]:
-				pos.x = ((pos.x % BackgroundWidthPixels) - BackgroundWidthPixels) % BackgroundWidthPixels;
-				pos.y = ((pos.y % BackgroundHeightPixels) - BackgroundHeightPixels) % BackgroundHeightPixels;
-
-				//move chunk if it doesn't overlap the screen:
-				if (pos.x + int32_t(ScreenWidth) <= 0) pos.x += BackgroundWidthPixels;
-				if (pos.y + int32_t(ScreenHeight) <= 0) pos.y += BackgroundHeightPixels;
-
-				int32_t ox = chunk_x / 8;
-				int32_t oy = chunk_y / 8;
-				for (int32_t y = 0; y < int32_t(BackgroundHeight)/2; ++y) {
-					for (int32_t x = 0; x < int32_t(BackgroundWidth)/2; ++x) {
-						uint16_t info = background[(x + ox) + BackgroundWidth * (y + oy)];
-						draw_tile(
-							glm::ivec2(pos.x + 8*x, pos.y + 8*y),
-							info & 0xff, //extract tile index bits
-							(info >> 8) & 0x07 //extract palette index bits
-						);
+	//helper to draw the sprite list (used because we need to draw the 'behind' sprites, then the background, then the 'front' sprites:
+	auto draw_sprites = [this,&draw_tile,&draw_tile_rows](uint8_t priority) {
+		for (uint32_t i = 0; i < sprites.size(); ++i) {
+			Sprite const &sprite = sprites[i];
+			if ((sprite.attributes & 0x80) != priority) continue;
+			if (sprites_per_scanline == 0 || !sprite_overflow) {
+				draw_tile(
+					glm::ivec2(sprite.x, sprite.y),
+					sprite.index,
+					sprite.attributes & 0x07, //just the palette index part
+					sprite.attributes & (FlipX | FlipY) //just the flip bits
+				);
+			} else {
+				//draw each run of rows that survived the scanline limit:
+				int32_t rows = int32_t(std::min< uint32_t >(8, ScreenHeight - std::min< uint32_t >(sprite.y, ScreenHeight)));
+				int32_t row = 0;
+				while (row < rows) {
+					while (row < rows && !(evaluation.shown[sprite.y + row] >> i & 1)) ++row;
+					int32_t begin = row;
+					while (row < rows && (evaluation.shown[sprite.y + row] >> i & 1)) ++row;
+					if (begin < row) {
+						draw_tile_rows(glm::ivec2(sprite.x, sprite.y), sprite.index, sprite.attributes & 0x07, sprite.attributes & (FlipX | FlipY), begin, row);
 					}
 				}
-
 			}
 		}
-	}
+	};
+
+	draw_sprites(0x80); //draw sprites with priority == 1 ('behind' sprites)
+
+	//the background gets drawn here:
+	GLsizei const front_begin = GLsizei(triangle_strip.size());
 
 	draw_sprites(0x00); //draw sprites with priority == 0 ('in front' sprites)
 
-	assert(triangle_strip.size() == TristripSize && "Triangle strip size was estimated exactly.");
+	assert(triangle_strip.size() <= TristripSize && "Triangle strip size was estimated correctly.");
 
 	//-------------------------------------------------
 	//Upload at to GPU using PPUDataStream:
 
-	{ //upload palette texture:
+	{ //upload palette texture (if it changed):
 		static_assert(sizeof(palette_table) == 4 * 4 * decltype(palette_table)().size(), "palette table is packed");
-		glBindTexture(GL_TEXTURE_2D, data_stream->palette_tex);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 4, GLsizei(palette_table.size()), 0, GL_RGBA, GL_UNSIGNED_BYTE, palette_table.data());
-		glBindTexture(GL_TEXTURE_2D, 0);
+		static decltype(palette_table) uploaded_palettes;
+		static bool palettes_uploaded = false;
+		if (!palettes_uploaded || std::memcmp(&uploaded_palettes, &palette_table, sizeof(palette_table)) != 0) {
+			glBindTexture(GL_TEXTURE_2D, data_stream->palette_tex);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 4, GLsizei(palette_table.size()), 0, GL_RGBA, GL_UNSIGNED_BYTE, palette_table.data());
+			glBindTexture(GL_TEXTURE_2D, 0);
+			uploaded_palettes = palette_table;
+			palettes_uploaded = true;
+		}
 	}
 
-	{ //build + upload tile table texture:
-		//interpret tiles and build a 128 x 128 index texture:
-		static std::array< uint8_t, 128 * 128 > data;
-		for (uint32_t i = 0; i < tile_table.size(); ++i) {
-			Tile const &tile = tile_table[i];
-
-			//location of tile in the texture:
-			uint32_t ox = (i % 16) * 8;
-			uint32_t oy = (i / 16) * 8;
-
-			//copy tile indices into texture:
-			for (uint32_t y = 0; y < 8; ++y) {
-				for (uint32_t x = 0; x < 8; ++x) {
-					data[ox+x + 128 * (oy+y)] =
-						  ((tile.bit0[y] >> x) & 1)
-						| ((tile.bit1[y] >> x) & 1) << 1;
+	{ //build + upload tile table texture (if it changed):
+		static_assert(sizeof(tile_table) == 16 * decltype(tile_table)().size(), "tile table is packed");
+		static decltype(tile_table) uploaded_tiles;
+		static bool tiles_uploaded = false;
+		if (!tiles_uploaded || std::memcmp(&uploaded_tiles, &tile_table, sizeof(tile_table)) != 0) {
+			//a registered tile bank comes with its texture:
+			uint8_t const *texels = nullptr;
+			for (auto const &registered : registered_tile_textures()) {
+				if (std::memcmp(&registered.tiles, &tile_table, sizeof(tile_table)) == 0) {
+					texels = registered.texels.data();
+					break;
 				}
 			}
+			//anything else gets interpreted into a 128 x 128 index texture here:
+			static std::array< uint8_t, TileTextureSize * TileTextureSize > data;
+			if (!texels) {
+				for (uint32_t i = 0; i < tile_table.size(); ++i) {
+					unpack_tile(tile_table[i], i, data.data());
+				}
+				texels = data.data();
+			}
+
+			glBindTexture(GL_TEXTURE_2D, data_stream->tile_tex);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, TileTextureSize, TileTextureSize, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, texels);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			uploaded_tiles = tile_table;
+			tiles_uploaded = true;
+		}
+	}
+
+	{ //upload changed rows and columns of background texture:
+		static_assert(sizeof(background) == 2 * BackgroundWidth * BackgroundHeight, "background is packed");
+
+		//the texture is shared, so if some other PPU466 drew last, all of it is out of date:
+		static PPU466 const *uploaded_by = nullptr;
+		if (uploaded_by != this) {
+			mark_background_dirty();
+			uploaded_by = this;
 		}
 
-		glBindTexture(GL_TEXTURE_2D, data_stream->tile_tex);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, 128, 128, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, data.data());
+		if (background_dirty_rows) {
+			glBindTexture(GL_TEXTURE_2D, data_stream->background_tex);
+			//one upload per run of changed rows:
+			uint32_t row = 0;
+			while (row < BackgroundHeight) {
+				while (row < BackgroundHeight && !(background_dirty_rows >> row & 1)) ++row;
+				uint32_t begin = row;
+				while (row < BackgroundHeight && (background_dirty_rows >> row & 1)) ++row;
+				if (begin < row) {
+					glTexSubImage2D(GL_TEXTURE_2D, 0, 0, GLint(begin), BackgroundWidth, GLsizei(row - begin), GL_RED_INTEGER, GL_UNSIGNED_SHORT, background.data() + BackgroundWidth * begin);
+				}
+			}
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+		//one upload per run of changed columns (unless every row went up already):
+		if (background_dirty_columns && background_dirty_rows != (1ULL << BackgroundHeight) - 1) {
+			glBindTexture(GL_TEXTURE_2D, data_stream->background_tex);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, BackgroundWidth); //(columns are read out of the row-major array)
+			uint32_t column = 0;
+			while (column < BackgroundWidth) {
+				while (column < BackgroundWidth && !(background_dirty_columns >> column & 1)) ++column;
+				uint32_t begin = column;
+				while (column < BackgroundWidth && (background_dirty_columns >> column & 1)) ++column;
+				if (begin < column) {
+					glTexSubImage2D(GL_TEXTURE_2D, 0, GLint(begin), 0, GLsizei(column - begin), BackgroundHeight, GL_RED_INTEGER, GL_UNSIGNED_SHORT, background.data() + begin);
+				}
+			}
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+		background_dirty_rows = 0;
+		background_dirty_columns = 0;
+	}
+
+	{ //upload background position of each scanline (960 bytes):
+		//reduce to [0,512) x [0,480) here so the shader's arithmetic never sees negative numbers:
+		constexpr int32_t BackgroundWidthPixels = int32_t(BackgroundWidth) * 8;
+		constexpr int32_t BackgroundHeightPixels = int32_t(BackgroundHeight) * 8;
+		static std::array< glm::i16vec2, ScreenHeight > data;
+		for (uint32_t y = 0; y < ScreenHeight; ++y) {
+			glm::ivec2 pos = background_position + glm::ivec2(scanline_scroll[y]);
+			pos.x = ((pos.x % BackgroundWidthPixels) + BackgroundWidthPixels) % BackgroundWidthPixels;
+			pos.y = ((pos.y % BackgroundHeightPixels) + BackgroundHeightPixels) % BackgroundHeightPixels;
+			data[y] = glm::i16vec2(pos);
+		}
+		static_assert(sizeof(data) == 960, "scroll table is packed");
+
+		glBindTexture(GL_TEXTURE_2D, data_stream->scroll_tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16I, ScreenHeight, 1, 0, GL_RG_INTEGER, GL_SHORT, data.data());
 		glBindTexture(GL_TEXTURE_2D, 0);
 	}
 
@@ -269,10 +479,29 @@ void PPU466::draw(glm::uvec2 const &drawable_size) const {
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, data_stream->tile_tex);
 
-	//now that the pipeline is configured, trigger drawing of triangle strip:
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, GLsizei(triangle_strip.size()));
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_2D, data_stream->scroll_tex);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, data_stream->background_tex);
+
+	//now that the pipeline is configured, trigger drawing of the 'behind' sprites:
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, front_begin);
+
+	//...the background, as one screen-covering quad:
+	glUseProgram(background_program->program);
+	glBindVertexArray(data_stream->empty_vertex_array);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	//...and the 'in front' sprites:
+	glUseProgram(tile_program->program);
+	glBindVertexArray(data_stream->vertex_buffer_for_tile_program);
+	glDrawArrays(GL_TRIANGLE_STRIP, front_begin, GLsizei(triangle_strip.size()) - front_begin);
 
 	//return state to default:
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, 0);
 	glActiveTexture(GL_TEXTURE1);
 	glBindTexture(GL_TEXTURE_2D, 0);
 	glActiveTexture(GL_TEXTURE0);
@@ -354,6 +583,68 @@ PPUTileProgram::~PPUTileProgram() {
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+PPUBackgroundProgram::PPUBackgroundProgram() {
+	static_assert((PPU466::FlipX << 8) == 0x4000 && (PPU466::FlipY << 8) == 0x2000, "flip bits match the shader below");
+	program = gl_compile_program(
+		//vertex shader:
+		"#version 330\n"
+		"out vec2 screenCoord;\n"
+		"void main() {\n"
+		"	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n" //(0,0), (1,0), (0,1), (1,1)
+		"	gl_Position = vec4(2.0 * corner - 1.0, 0.0, 1.0);\n"
+		"	screenCoord = corner * vec2(256.0, 240.0);\n"
+		"}\n"
+	,
+		//fragment shader:
+		"#version 330\n"
+		"uniform usampler2D TILE_TABLE;\n"
+		"uniform sampler2D PALETTE_TABLE;\n"
+		"uniform usampler2D BACKGROUND;\n"
+		"uniform isampler2D SCROLL;\n"
+		"in vec2 screenCoord;\n"
+		"out vec4 fragColor;\n"
+		"void main() {\n"
+		"	ivec2 pixel = ivec2(screenCoord);\n"
+		//background position for this scanline (already reduced to [0,512)x[0,480), so 'at' is never negative):
+		"	ivec2 scroll = texelFetch(SCROLL, ivec2(pixel.y, 0), 0).rg;\n"
+		"	ivec2 at = (pixel - scroll + ivec2(512, 480)) % ivec2(512, 480);\n"
+		"	uint info = texelFetch(BACKGROUND, at / 8, 0).r;\n"
+		"	uint tile = info & 0xffu;\n"
+		"	int palette = int((info >> 8) & 0x7u);\n"
+		"	ivec2 inTile = at % 8;\n"
+		"	if ((info & 0x4000u) != 0u) inTile.x = 7 - inTile.x;\n" //flip left-to-right (FlipX << 8)
+		"	if ((info & 0x2000u) != 0u) inTile.y = 7 - inTile.y;\n" //flip top-to-bottom (FlipY << 8)
+		"	ivec2 tileCoord = 8 * ivec2(tile % 16u, tile / 16u) + inTile;\n"
+		"	uint index = texelFetch(TILE_TABLE, tileCoord, 0).r;\n"
+		"	fragColor = texelFetch(PALETTE_TABLE, ivec2(index, palette), 0);\n"
+		"}\n"
+	);
+
+	GLuint TILE_TABLE_usampler2D = glGetUniformLocation(program, "TILE_TABLE");
+	GLuint PALETTE_TABLE_sampler2D = glGetUniformLocation(program, "PALETTE_TABLE");
+	GLuint BACKGROUND_usampler2D = glGetUniformLocation(program, "BACKGROUND");
+	GLuint SCROLL_isampler2D = glGetUniformLocation(program, "SCROLL");
+
+	//bind texture units indices to samplers:
+	glUseProgram(program);
+	glUniform1i(TILE_TABLE_usampler2D, 0);
+	glUniform1i(PALETTE_TABLE_sampler2D, 1);
+	glUniform1i(BACKGROUND_usampler2D, 2);
+	glUniform1i(SCROLL_isampler2D, 3);
+	glUseProgram(0);
+
+	GL_ERRORS();
+}
+
+PPUBackgroundProgram::~PPUBackgroundProgram() {
+	if (program != 0) {
+		glDeleteProgram(program);
+		program = 0;
+	}
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
 
 //PPU data is streamed to the GPU (read: uploaded 'just in time') using a few buffers:
 PPUDataStream::PPUDataStream() {
@@ -401,6 +692,9 @@ PPUDataStream::PPUDataStream() {
 
 	glBindVertexArray(0);
 
+	//(a vertex array object must be bound to draw, even with no attributes)
+	glGenVertexArrays(1, &empty_vertex_array);
+
 
 	glGenTextures(1, &tile_tex);
 	glBindTexture(GL_TEXTURE_2D, tile_tex);
@@ -430,6 +724,27 @@ PPUDataStream::PPUDataStream() {
 	glBindTexture(GL_TEXTURE_2D, 0);
 
 
+	//the background and scroll textures are only ever read with texelFetch, but get the same parameters anyway:
+	glGenTextures(1, &background_tex);
+	glBindTexture(GL_TEXTURE_2D, background_tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R16UI, PPU466::BackgroundWidth, PPU466::BackgroundHeight, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+
+	glGenTextures(1, &scroll_tex);
+	glBindTexture(GL_TEXTURE_2D, scroll_tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16I, PPU466::ScreenHeight, 1, 0, GL_RG_INTEGER, GL_SHORT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+
 	GL_ERRORS();
 }
 
@@ -450,4 +765,16 @@ PPUDataStream::~PPUDataStream() {
 		glDeleteTextures(1, &palette_tex);
 		palette_tex = 0;
 	}
+	if (background_tex != 0) {
+		glDeleteTextures(1, &background_tex);
+		background_tex = 0;
+	}
+	if (scroll_tex != 0) {
+		glDeleteTextures(1, &scroll_tex);
+		scroll_tex = 0;
+	}
+	if (empty_vertex_array != 0) {
+		glDeleteVertexArrays(1, &empty_vertex_array);
+		empty_vertex_array = 0;
+	}
 }
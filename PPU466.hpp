@@ -6,8 +6,12 @@
  *
  */
 
+#include "Checksum.hpp"
+
 #include <glm/glm.hpp>
+#include <algorithm>
 #include <array>
+#include <vector>
 
 struct PPU466 {
 	PPU466();
@@ -64,13 +68,122 @@ struct PPU466 {
 	struct Tile {
 		std::array< uint8_t, 8 > bit0; //<-- controls bit 0 of the color index
 		std::array< uint8_t, 8 > bit1; //<-- controls bit 1 of the color index
+
+		//Opacity mask:
+		// (bit0[y] | bit1[y]) is set wherever a pixel of row y uses a color other than color 0;
+		// the opacity mask packs those eight rows into one 64-bit value, bottom row in the low byte:
+		//   bit (x + 8*y) of the mask <-> pixel (x,y) of the tile
+		// (this assumes the "true NES" convention that color 0 of the palette is transparent)
+		uint64_t opacity_mask() const {
+			uint64_t mask = 0;
+			for (uint32_t y = 0; y < 8; ++y) {
+				mask |= uint64_t(bit0[y] | bit1[y]) << (8 * y);
+			}
+			return mask;
+		}
+
+		//The same tile mirrored left-to-right (FlipX) and/or top-to-bottom (FlipY):
+		// (what a sprite or background entry with those flip bits shows; see below)
+		Tile flipped(uint8_t flip) const {
+			Tile ret = *this;
+			if (flip & FlipY) {
+				std::reverse(ret.bit0.begin(), ret.bit0.end());
+				std::reverse(ret.bit1.begin(), ret.bit1.end());
+			}
+			if (flip & FlipX) {
+				for (uint32_t y = 0; y < 8; ++y) {
+					ret.bit0[y] = reverse_bits(ret.bit0[y]);
+					ret.bit1[y] = reverse_bits(ret.bit1[y]);
+				}
+			}
+			return ret;
+		}
 	};
 	static_assert(sizeof(Tile) == 16, "Tile is packed");
 
+	//Flip bits:
+	// sprites and background entries can show their tile mirrored, so one tile can serve several images:
+	//   for sprites, these are bits of the 'attributes' byte; for the background, they are shifted up by 8
+	enum : uint8_t {
+		FlipX = 0x40, //mirror left-to-right
+		FlipY = 0x20, //mirror top-to-bottom
+	};
+
+	//An opacity mask (see Tile::opacity_mask()) of a tile, as shown with flip bits 'flip':
+	static uint64_t flip_opacity_mask(uint64_t mask, uint8_t flip) {
+		uint64_t ret = 0;
+		for (uint32_t y = 0; y < 8; ++y) {
+			uint8_t row = uint8_t(mask >> (8 * y));
+			if (flip & FlipX) row = reverse_bits(row);
+			ret |= uint64_t(row) << (8 * ((flip & FlipY) ? 7 - y : y));
+		}
+		return ret;
+	}
+
+	static uint8_t reverse_bits(uint8_t b) {
+		b = uint8_t((b & 0xf0) >> 4 | (b & 0x0f) << 4);
+		b = uint8_t((b & 0xcc) >> 2 | (b & 0x33) << 2);
+		b = uint8_t((b & 0xaa) >> 1 | (b & 0x55) << 1);
+		return b;
+	}
+
+	//Pixel-exact overlap test between two tiles:
+	// 'a' and 'b' are opacity masks (see Tile::opacity_mask())
+	// 'offset' is the position of b's lower-left pixel relative to a's lower-left pixel
+	//returns true if any opaque pixel of a covers the same screen pixel as an opaque pixel of b.
+	//
+	//This is just a few shifts and ANDs, so it is cheap enough to use as the narrow phase after (or instead of) a box test.
+	static bool opacity_masks_overlap(uint64_t a, uint64_t b, glm::ivec2 const &offset) {
+		//tiles more than 7 pixels apart can't overlap:
+		if (offset.x <= -8 || offset.x >= 8 || offset.y <= -8 || offset.y >= 8) return false;
+
+		//move b's columns by offset.x within each row, dropping pixels that fall off the side of a row:
+		constexpr uint64_t EveryRow = 0x0101010101010101ULL;
+		if (offset.x >= 0) {
+			b = (b << offset.x) & (EveryRow * uint8_t(0xff << offset.x));
+		} else {
+			b = (b >> -offset.x) & (EveryRow * uint8_t(0xff >> -offset.x));
+		}
+
+		//move b's rows by offset.y:
+		if (offset.y >= 0) {
+			b <<= 8 * offset.y;
+		} else {
+			b >>= 8 * -offset.y;
+		}
+
+		return (a & b) != 0;
+	}
+
+	//Convenience wrapper for opacity_masks_overlap():
+	// tile 'a' drawn with its lower-left at 'a_at', tile 'b' drawn with its lower-left at 'b_at':
+	static bool tiles_overlap(Tile const &a, glm::ivec2 const &a_at, Tile const &b, glm::ivec2 const &b_at) {
+		return opacity_masks_overlap(a.opacity_mask(), b.opacity_mask(), b_at - a_at);
+	}
+
 	//Tile Table:
 	// The PPU has a 256-tile 'pattern memory' in which tiles are stored:
 	//  this is often thought of as a 16x16 grid of tiles.
 	std::array< Tile, 16 * 16 > tile_table;
+	//
+	// To draw, the tile table is unpacked into a 128x128 texture of color indices (0-3), tile i
+	//  at ((i % 16) * 8, (i / 16) * 8), bottom row of each tile first:
+	enum : uint32_t { TileTextureSize = 128 };
+	static void unpack_tile(Tile const &tile, uint32_t index, uint8_t *texels) {
+		uint32_t ox = (index % 16) * 8;
+		uint32_t oy = (index / 16) * 8;
+		for (uint32_t y = 0; y < 8; ++y) {
+			for (uint32_t x = 0; x < 8; ++x) {
+				texels[ox+x + TileTextureSize * (oy+y)] =
+					  ((tile.bit0[y] >> x) & 1)
+					| ((tile.bit1[y] >> x) & 1) << 1;
+			}
+		}
+	}
+	// draw() only re-does this when the tile table changed since it last did; and if the new table is one
+	//  registered here (e.g., from the asset converter's tile_texture.chunk), its texels are uploaded as they are,
+	//  so startup and switching between registered tile banks skip the unpacking entirely:
+	static void register_tile_texture(std::array< Tile, 16 * 16 > const &tiles, std::vector< uint8_t > const &texels);
 
 	//Background Layer:
 	// The PPU's background layer is made of 64x60 tiles (512 x 480 pixels):
@@ -84,14 +197,45 @@ struct PPU466 {
 	//  each value in the grid gives:
 	//    - bits 0-7: tile table index
 	//    - bits 8-10: palette table index
-	//    - bits 11-15: unused, should be 0
+	//    - bit 13: flip top-to-bottom (FlipY << 8)
+	//    - bit 14: flip left-to-right (FlipX << 8)
+	//    - bits 11, 12, 15: unused, should be 0
 	//
 	//  bits:  F E D C B A 9 8 7 6 5 4 3 2 1 0
-	//        |---------|-----|---------------|
-	//            ^        ^        ^-- tile index
-	//            |        '----------- palette index
-	//            '-------------------- unused (set to zero)
+	//        |-|-|-|---|-----|---------------|
+	//         ^ ^ ^  ^    ^        ^-- tile index
+	//         | | |  |    '----------- palette index
+	//         | | |  '---------------- unused (set to zero)
+	//         | | '------------------- flip top-to-bottom
+	//         | '--------------------- flip left-to-right
+	//         '----------------------- unused (set to zero)
 	std::array< uint16_t, BackgroundWidth * BackgroundHeight > background;
+	//
+	// Read 'background' freely, but change it with these functions, which keep track of
+	//  the rows that changed so that draw() only re-uploads those (and nothing, if none did):
+	void set_background(uint32_t x, uint32_t y, uint16_t value) {
+		background[x + BackgroundWidth * y] = value;
+		background_dirty_rows |= (1ULL << y);
+	}
+	//copy a width x height rectangle of row-major values, lower-left at (x,y):
+	void set_background_rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint16_t const *values);
+	//set every entry of a width x height rectangle, lower-left at (x,y), to one value:
+	void fill_background_rect(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint16_t value);
+	//copy 'height' values into column x, bottom to top from (x,y) (the layout of level nametables; see Level.hpp):
+	// (this marks the column, not its rows, so streaming in a column re-uploads just that column)
+	void set_background_column(uint32_t x, uint32_t y, uint32_t height, uint16_t const *values);
+	//after writing 'background' directly (or replacing the whole PPU466), say which rows changed:
+	void mark_background_dirty(uint32_t row_begin = 0, uint32_t row_end = BackgroundHeight) const {
+		for (uint32_t row = row_begin; row < row_end; ++row) {
+			background_dirty_rows |= (1ULL << row);
+		}
+	}
+	//bit y set <-> row y changed since the last draw() (everything starts out changed):
+	static_assert(BackgroundHeight <= 64, "dirty rows fit in a 64-bit mask");
+	mutable uint64_t background_dirty_rows = (1ULL << BackgroundHeight) - 1;
+	//bit x set <-> column x changed since the last draw() (see set_background_column):
+	static_assert(BackgroundWidth <= 64, "dirty columns fit in a 64-bit mask");
+	mutable uint64_t background_dirty_columns = 0;
 
 	//Background Position:
 	// The background's lower-left pixel can positioned anywhere
@@ -102,6 +246,13 @@ struct PPU466 {
 	// thus, background_position values of (x,y) and of (x+n*512,y+m*480) for
 	// any integers n,m will look the same
 
+	//Scanline Scroll:
+	// Each scanline (row of screen pixels, 0 at the bottom) can move the background a bit more:
+	//   the background position used for scanline y is background_position + scanline_scroll[y]
+	// this allows raster effects like a fixed status bar over a scrolling level or parallax strips.
+	// (it costs nothing extra to draw: the table is uploaded as one 960-byte texture every frame)
+	std::array< glm::i16vec2, ScreenHeight > scanline_scroll;
+
 	//Sprite:
 	// On the PPU, all non-background objects are called 'sprites':
 	//
@@ -113,10 +264,12 @@ struct PPU466 {
 	//
 	//  the sprite 'attributes' byte gives:
 	//   bits:  7 6 5 4 3 2 1 0
-	//         |-|-------|-----|
-	//          ^    ^      ^
-	//          |    |      '---- palette index (bits 0-2)
-	//          |    '----------- unused (set to zero)
+	//         |-|-|-|---|-----|
+	//          ^ ^ ^  ^    ^
+	//          | | |  |    '---- palette index (bits 0-2)
+	//          | | |  '--------- unused (set to zero)
+	//          | | '------------ flip top-to-bottom (bit 5, FlipY)
+	//          | '-------------- flip left-to-right (bit 6, FlipX)
 	//          '---------------- priority bit (bit 7)
 	//
 	//  the 'priority bit' chooses whether to render the sprite
@@ -140,4 +293,45 @@ struct PPU466 {
 	//  any sprites you don't want to use should be moved off the screen (y >= 240)
 	std::array< Sprite, 64 > sprites;
 
+	//Scanline sprite limit:
+	// The NES could only draw eight sprites on any one row of pixels ("scanline");
+	//  set sprites_per_scanline to emulate a limit like that (0 means no limit).
+	// With a limit, each scanline only shows the last sprites_per_scanline sprites
+	//  (in 'sprites' order -- the front-most ones, since later sprites draw on top) that cover it;
+	//  the rest are cut from that scanline,
+	//  and draw() sets sprite_overflow (which stays clear without a limit).
+	uint32_t sprites_per_scanline = 0;
+	mutable bool sprite_overflow = false;
+
+	//Which sprites cover each scanline (and which of those a given limit would keep):
+	// built with one pass over 'sprites', as a 64-bit mask (bit i = sprite i) per scanline.
+	struct ScanlineEvaluation {
+		std::array< uint64_t, ScreenHeight > covering; //sprites that cover each scanline
+		std::array< uint64_t, ScreenHeight > shown; //...limited to the last (front-most) 'limit' of them
+		uint32_t overflow_scanlines = 0; //scanlines that had more than 'limit' covering sprites
+		uint32_t busiest_scanline = 0; //scanline with the most covering sprites
+		uint32_t busiest_count = 0; //number of sprites covering busiest_scanline
+	};
+	//evaluate with 'limit' sprites per scanline (0 = no limit); handy for checking a limit without enforcing it:
+	void evaluate_scanlines(uint32_t limit, ScanlineEvaluation *evaluation) const;
+
+	//--------------------------------------------------------------
+	//Hash of everything above (for checking that two runs drew the same thing):
+	uint64_t checksum() const {
+		Checksum checksum;
+		checksum.add_value(background_color);
+		checksum.add(palette_table.data(), sizeof(palette_table));
+		checksum.add(tile_table.data(), sizeof(tile_table));
+		checksum.add(background.data(), sizeof(background));
+		checksum.add_value(background_position);
+		for (auto const &scroll : scanline_scroll) {
+			if (scroll != glm::i16vec2(0)) { //(so checksums without scanline scroll stay the same as before)
+				checksum.add(scanline_scroll.data(), sizeof(scanline_scroll));
+				break;
+			}
+		}
+		checksum.add(sprites.data(), sizeof(sprites));
+		if (sprites_per_scanline) checksum.add_value(sprites_per_scanline); //(so checksums without a limit stay the same as before)
+		return checksum.digest();
+	}
 };
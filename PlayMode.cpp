@@ -3,96 +3,204 @@
 //for the GL_ERRORS() macro:
 #include "gl_errors.hpp"
 
+#include "Level.hpp"
+
 //for glm::value_ptr() :
 #include <glm/gtc/type_ptr.hpp>
 
-#include <random>
 #include <array>
+#include <chrono>
+#include <random>
+#include <type_traits>
 
-PlayMode::PlayMode() {
-	std::vector<PPU466::Tile> tile_input;
-	std::vector<PPU466::Palette> palette_input;
-	std::ifstream tile_stream(data_path("assets/tiles.chunk"), std::ios::binary);
-	std::ifstream palette_stream(data_path("assets/palettes.chunk"), std::ios::binary);
-	if (tile_stream.is_open() && palette_stream.is_open()){
-		std::cout<<"Input stream open success"<<std::endl;
-	}
-	read_chunk(tile_stream, "til0", &tile_input);
-	read_chunk(palette_stream, "plt0", &palette_input);
+//rewind history budget:
+// (enough captures for ten seconds of 60Hz updates; history measured at ~40KB per second --
+//  ~350 byte deltas, plus one ~21KB keyframe per second -- so ten seconds fit comfortably)
+static constexpr uint32_t RewindCaptures = 60 * 10;
+static constexpr size_t RewindArenaBytes = 1 << 20;
+
+static_assert(std::is_trivially_copyable< PPU466 >::value, "PPU466 is plain data (so RewindBuffer can capture it)");
+
+//(the tile table and palettes are compiled in -- see assets_embedded.hpp -- so there's nothing to read for them)
+PlayMode::PlayMode() : PlayMode(GameState::load_tiles()) {
+}
+
+PlayMode::PlayMode(std::vector<PPU466::Tile> const &tile_input) : game(tile_input),
+	rewind({ {&game, sizeof(game)}, {&ppu, sizeof(ppu)}, {&background_fade, sizeof(background_fade)} }, RewindCaptures, RewindArenaBytes) {
+	//(unused tiles are blank, as in the table the converter pre-unpacks into tile_texture.chunk)
+	ppu.tile_table.fill(PPU466::Tile{});
 	std::copy(tile_input.begin(),tile_input.end(), ppu.tile_table.begin());
-	std::copy(palette_input.begin(), palette_input.end(), ppu.palette_table.begin());
-
-	for (uint32_t i = 0; i < ppu.background.size(); ++i) {
-		if (i < 128){
-			ppu.background[i] = int16_t(
-				WAVE_DOWN_PALETTE_IDX << 8
-				| WAVE_DOWN_TILE_IDX
-			);
-		} else if (i < 192){
-			ppu.background[i] = int16_t(
-				WAVE_UP_PALETTE_IDX << 8
-				| WAVE_UP_TILE_IDX
-			);
-		} else {
-			ppu.background[i] = int16_t(
-				WHITE_PALETTE_IDX << 8
-				| WHITE_TILE_IDX
-			);
+	{ //the converter's pre-unpacked tile texture, if it made one (otherwise PPU466::draw() unpacks the tiles itself):
+		std::ifstream texture_stream(data_path("assets/tile_texture.chunk"), std::ios::binary);
+		if (texture_stream) {
+			std::vector< PPU466::Tile > texture_tiles;
+			std::vector< uint8_t > texels;
+			read_chunk(texture_stream, "ttl0", &texture_tiles);
+			read_chunk(texture_stream, "ttx0", &texels);
+			if (texture_tiles.size() == ppu.tile_table.size()) {
+				std::array< PPU466::Tile, 16 * 16 > tiles;
+				std::copy(texture_tiles.begin(), texture_tiles.end(), tiles.begin());
+				PPU466::register_tile_texture(tiles, texels);
+			}
 		}
 	}
+	assets::copy_palettes(&ppu.palette_table);
+
+	//sea along the bottom, sky above (assets/levels/sea.png):
+	{
+		Levels levels;
+		levels.load(data_path("assets/levels.chunk"));
+		levels.copy(assets::levels::sea.index, glm::uvec2(0), glm::uvec2(PPU466::BackgroundWidth, PPU466::BackgroundHeight), &ppu);
+	}
+	std::mt19937 mt(game.seed); //(clouds are part of the session, so they come from its seed too)
 	for (int i=0; i<num_cloud; i++){
-		static std::mt19937 mt;
 		cloud_idx.push_back((mt()%17+10)*64+mt()%50);
 	}
 
 	for (uint32_t i=0; i<cloud_idx.size(); i++){
-		ppu.background[cloud_idx[i]] = int16_t(
-			CLOUD_LEFT_PALETTE_IDX << 8
-			| CLOUD_LEFT_TILE_IDX
-		);
-		ppu.background[cloud_idx[i]+1] = int16_t(
-			CLOUD_RIGHT_PALETTE_IDX << 8
-			| CLOUD_RIGHT_TILE_IDX
-		);
+		uint16_t const cloud[2] = {
+			assets::sprites::cloud_left.background_entry(),
+			assets::sprites::cloud_right.background_entry(),
+		};
+		ppu.set_background_rect(cloud_idx[i] % PPU466::BackgroundWidth, cloud_idx[i] / PPU466::BackgroundWidth, 2, 1, cloud);
 	}
 
+	rewind.push(); //(so rewinding can go all the way back to the start)
+}
 
+PlayMode::~PlayMode() {
+	sprites.report(std::cout);
+	if (overflow_report_limit) {
+		std::cout << "Scanline overflow (" << overflow_report_limit << " sprites per scanline): "
+		          << overflow_frames << " of " << overflow_frames_checked << " frames overflowed, in "
+		          << overflow_streaks << " streaks; at most " << overflow_busiest_count << " sprites on one scanline." << std::endl;
+	}
 
-	for (uint32_t i=0; i<num_fish; i++){
-		fish_at.push_back(glm::vec2(0.0f, 240.0f));
-		fish_velocity.push_back(glm::vec2(0.0f, 0.0f));
-		fish_active.push_back(false);
+	if (!recording_filename.empty()) {
+		std::cout << "Saving " << recording.header.frames << " frames of recording to '" << recording_filename << "'." << std::endl;
+		try {
+			recording.save(recording_filename);
+		} catch (std::exception const &e) {
+			std::cerr << e.what() << std::endl; //(destructors can't throw)
+		}
 	}
+}
 
-	for (uint32_t i=0; i<num_whale; i++){
-		whale_at.push_back(glm::vec2(0.0f, 240.0f));
-		whale_velocity.push_back(glm::vec2(0.0f, 0.0f));
-		whale_active.push_back(false);
+void PlayMode::start_recording(std::string const &filename) {
+	recording_filename = filename;
+	recording.begin(game);
+}
+
+void PlayMode::start_checksum_log(std::string const &filename) {
+	checksum_log.open(filename);
+	if (!checksum_log) {
+		throw std::runtime_error("Failed to open checksum log '" + filename + "'.");
 	}
+	checksum_log << "#update game_checksum ppu_checksum\n";
+}
 
-	for (uint32_t i=0; i<num_bomb; i++){
-		bomb_at.push_back(glm::vec2(0.0f, 240.0f));
-		bomb_velocity.push_back(glm::vec2(0.0f, 0.0f));
-		bomb_active.push_back(false);
+void PlayMode::check_scanline_overflow() {
+	ppu.evaluate_scanlines(overflow_report_limit, &overflow_evaluation);
+	overflow_frames_checked += 1;
+	overflow_busiest_count = std::max(overflow_busiest_count, overflow_evaluation.busiest_count);
+
+	bool overflowed = (overflow_evaluation.overflow_scanlines > 0);
+	if (overflowed) {
+		overflow_frames += 1;
+		//only mention the start of each streak of overflowing frames, to keep the log readable:
+		if (!overflowing) {
+			overflow_streaks += 1;
+			std::cout << "Scanline overflow at update " << updates << ": "
+			          << overflow_evaluation.overflow_scanlines << " scanlines over " << overflow_report_limit
+			          << ", busiest is scanline " << overflow_evaluation.busiest_scanline
+			          << " with " << overflow_evaluation.busiest_count << " sprites." << std::endl;
+		}
 	}
-	
+	overflowing = overflowed;
+}
 
+void PlayMode::save_snapshot(std::string const &filename) const {
+	auto before = std::chrono::high_resolution_clock::now();
+	Snapshot snapshot(game, ppu, background_fade);
+	auto taken = std::chrono::high_resolution_clock::now();
+	snapshot.save(filename);
+	auto after = std::chrono::high_resolution_clock::now();
+	std::cout << "Saved " << sizeof(Snapshot) << " byte snapshot to '" << filename << "' (took "
+	          << std::chrono::duration< double, std::micro >(taken - before).count() << "us + "
+	          << std::chrono::duration< double, std::micro >(after - taken).count() << "us to write)." << std::endl;
 }
 
-PlayMode::~PlayMode() {
+void PlayMode::load_snapshot(std::string const &filename) {
+	auto before = std::chrono::high_resolution_clock::now();
+	Snapshot snapshot(game, ppu, background_fade);
+	snapshot.load(filename);
+	auto loaded = std::chrono::high_resolution_clock::now();
+	uint32_t sprites_per_scanline = ppu.sprites_per_scanline; //(a setting for this session, not part of the saved one)
+	snapshot.restore(&game, &ppu, &background_fade);
+	ppu.sprites_per_scanline = sprites_per_scanline;
+	auto after = std::chrono::high_resolution_clock::now();
+	std::cout << "Loaded snapshot from '" << filename << "' (took "
+	          << std::chrono::duration< double, std::micro >(loaded - before).count() << "us to read + "
+	          << std::chrono::duration< double, std::micro >(after - loaded).count() << "us to restore)." << std::endl;
+
+	//the keyboard may disagree with the restored state about space:
+	if (game.space_key.pressed && !space_held) game_input(GameState::InputEvent::SpaceUp);
+	if (!game.space_key.pressed && space_held) game_input(GameState::InputEvent::SpaceDown);
+
+	//rewinding past the load would go back to a different session:
+	rewind.clear();
+	rewind.push();
+}
+
+void PlayMode::game_input(GameState::InputEvent evt) {
+	game.handle_input(evt);
+	if (!recording_filename.empty()) recording.record_input(evt);
 }
 
 bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size) {
 
 	if (evt.type == SDL_KEYDOWN) {
 		if (evt.key.keysym.sym == SDLK_SPACE) {
-			space_key.downs += 1;
-			space_key.pressed = true;
+			space_held = true;
+			if (!rewinding) game_input(GameState::InputEvent::SpaceDown);
+			return true;
+		} else if (evt.key.keysym.sym == SDLK_BACKSPACE && recording_filename.empty()) {
+			rewinding = true;
+			return true;
+		} else if (evt.key.keysym.sym == SDLK_F5 && !snapshot_filename.empty()) {
+			try {
+				save_snapshot(snapshot_filename);
+			} catch (std::exception const &e) {
+				std::cerr << e.what() << std::endl;
+			}
+			return true;
+		} else if (evt.key.keysym.sym == SDLK_F9 && !snapshot_filename.empty() && recording_filename.empty() && !rewinding) {
+			try {
+				load_snapshot(snapshot_filename);
+			} catch (std::exception const &e) {
+				std::cerr << e.what() << std::endl;
+			}
 			return true;
 		}
 	} else if (evt.type == SDL_KEYUP) {
 		if (evt.key.keysym.sym == SDLK_SPACE) {
-			space_key.pressed = false;
+			space_held = false;
+			if (!rewinding) game_input(GameState::InputEvent::SpaceUp);
+			return true;
+		} else if (evt.key.keysym.sym == SDLK_BACKSPACE && rewinding) {
+			rewinding = false;
+			//the keyboard may disagree with the restored state about space:
+			if (game.space_key.pressed && !space_held) game_input(GameState::InputEvent::SpaceUp);
+			if (!game.space_key.pressed && space_held) game_input(GameState::InputEvent::SpaceDown);
+
+			if (rewind_steps) {
+				std::cout << "Rewound " << rewind_steps << " updates; step back took " << (rewind_seconds_total / rewind_steps * 1e6) << "us on average, " << (rewind_seconds_max * 1e6) << "us at most.\n";
+			}
+			std::cout << "Rewind history: " << rewind.size() << " updates in " << rewind.bytes_used() << " bytes ("
+			          << (rewind.size() ? rewind.bytes_used() / rewind.size() : 0) << " bytes per update; " << rewind.state_size() << " bytes uncompressed)." << std::endl;
+			rewind_steps = 0;
+			rewind_seconds_total = 0.0;
+			rewind_seconds_max = 0.0;
 			return true;
 		}
 	}
@@ -101,105 +209,32 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
 }
 
 
-void PlayMode::update_target(std::vector<glm::vec2>& at, std::vector<glm::vec2>& velocity, std::vector<bool>& active, uint8_t num, float elapsed){
-	constexpr float Gravity = 20.0f;
-	for (int i=0; i<num; i++){
-		if (active[i]){
-			velocity[i].y -= Gravity * elapsed;
-			at[i].x += velocity[i].x * elapsed;
-			at[i].y += velocity[i].y * elapsed;
-			if (at[i].y < 0.0f || at[i].x < 0.0f || at[i].x > 256.0f){
-				active[i] = false;
-				at[i].y = 240;
-			}
-		} else {
-			static std::mt19937 mt;
-			if ((mt()/float(mt.max())) < 0.01f){
-				active[i] = true;
-			 	at[i].y = 0.0f;
-				at[i].x = (mt()/float(mt.max())) * 256.0f;
-				velocity[i].x = (mt()/float(mt.max()))*40.0f - 20.0f;
-				velocity[i].y = 80.0f;
-			}
+void PlayMode::update(float elapsed) {
+	if (rewinding) {
+		//go back one update per update:
+		auto before = std::chrono::high_resolution_clock::now();
+		bool stepped = rewind.step_back();
+		auto after = std::chrono::high_resolution_clock::now();
+		ppu.mark_background_dirty(); //(the rewound dirty rows say nothing about what is on the GPU now)
+		if (stepped) {
+			double seconds = std::chrono::duration< double >(after - before).count();
+			rewind_steps += 1;
+			rewind_seconds_total += seconds;
+			rewind_seconds_max = std::max(rewind_seconds_max, seconds);
 		}
+		return;
 	}
-}
-bool pt_in(float pt_x,float pt_y, glm::vec2 target){
-	if (pt_x>=target.x && pt_x<=target.x+8 && pt_y >= target.y && pt_y<=target.y+8){
-		return true;
-	}
-	return false;
-}
 
-void check_hit(std::vector<glm::vec2>& at, glm::vec2 p, std::vector<bool>& active, int pts, int& score){
-	for(uint32_t i = 0; i<at.size();i++){
-		if(at[i].y == 240){
-			continue;
-		}
-		bool hit = pt_in(p.x,p.y,at[i]) || pt_in(p.x+8,p.y,at[i]) 
-					|| pt_in(p.x+8,p.y+8,at[i]) || pt_in(p.x,p.y+8,at[i]);
-		if(hit){
-			active[i] = false;
-			at[i].y = 240;
-			score += pts;
-			score = std::max(score, 0);
-		}
-	}
-}
+	game.update(elapsed);
+	updates += 1;
+	if (!recording_filename.empty()) recording.record_frame(elapsed, game);
 
-void PlayMode::update(float elapsed) {
-	if (game_stop){
-		return;
-	}
-	time_remain -= elapsed;
-	if (time_remain <=0){
-		game_stop = true;
-	}
 	//slowly rotates through [0,1):
 	// (will be used to set background color)
 	background_fade += elapsed / 10.0f;
 	background_fade -= std::floor(background_fade);
 
-	//reset button press counters:
-	space_key.downs = 0;
-
-	if (space_key.pressed) {
-		if (boomerang_state == BoomerangState::INACTIVE) {
-			boomerang_state = BoomerangState::HOLDING;
-			boomerang_holding_time = elapsed;
-		} else if (boomerang_state == BoomerangState::HOLDING) {
-			boomerang_holding_time += elapsed;
-		}
-	} else {
-		if (boomerang_state == BoomerangState::HOLDING) {
-			boomerang_state = BoomerangState::FLYING;
-			boomerang_vec_x =
-				std::min<double>(BOOMERANG_INIT_SPEED_COEFFICIENT * boomerang_holding_time, BOOMERANG_MAX_SPEED);
-		}
-	}
-
-	if (boomerang_state == BoomerangState::FLYING) {
-		boomerang_at.x += (float)(boomerang_vec_x * elapsed);
-		boomerang_vec_x -= BOOMERANG_ACCELERATION * elapsed;
-		if (boomerang_at.x <= 0) {
-			boomerang_vec_x = 0;
-			boomerang_state = BoomerangState::INACTIVE;
-			boomerang_at.x = 0;
-		}
-	}
-
-
-
-	update_target(fish_at, fish_velocity, fish_active, num_fish, elapsed);
-	update_target(whale_at, whale_velocity, whale_active, num_whale, elapsed);
-	update_target(bomb_at, bomb_velocity, bomb_active, num_bomb, elapsed);
-
-	//check if boomrang hit target
-	check_hit(fish_at, boomerang_at, fish_active,1,score);
-	check_hit(whale_at,boomerang_at, whale_active,10,score);
-	check_hit(bomb_at, boomerang_at,bomb_active,-10,score);
-
-
+	if (recording_filename.empty()) rewind.push();
 }
 
 
@@ -208,93 +243,104 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 
 	// background scroll feature removed
 
-	//player sprite:
-	ppu.sprites[0].x = uint8_t(std::min<double>(boomerang_at.x, 255.0));
-	ppu.sprites[0].y = uint8_t(boomerang_at.y);
-	if (boomerang_state != BoomerangState::FLYING || boomerang_vec_x >= 0.0) {
-		ppu.sprites[0].index = BOOMERANG_RIGHT_TILE_IDX;
-		ppu.sprites[0].attributes = BOOMERANG_RIGHT_PALETTE_IDX;
-	} else {
-		ppu.sprites[0].index = BOOMERANG_LEFT_TILE_IDX;
-		ppu.sprites[0].attributes = BOOMERANG_LEFT_PALETTE_IDX;
-	}
-
-
-	//target sprite:
-	for (int i=0; i<num_fish; i++){
-		ppu.sprites[i+1].x = int32_t(fish_at[i].x);
-		ppu.sprites[i+1].y = int32_t(fish_at[i].y);
-		ppu.sprites[i+1].index = FISH_TILE_IDX;
-		ppu.sprites[i+1].attributes = FISH_PALETTE_IDX;
-	}
-
-	for (int i=0; i<num_whale; i++){
-		ppu.sprites[i+num_fish+1].x = int32_t(whale_at[i].x);
-		ppu.sprites[i+num_fish+1].y = int32_t(whale_at[i].y);
-		ppu.sprites[i+num_fish+1].index = WHALE_TILE_IDX;
-		ppu.sprites[i+num_fish+1].attributes = WHALE_PALETTE_IDX;
-	}
-
-	for (int i=0; i<num_bomb; i++){
-		ppu.sprites[i+num_fish+num_whale+1].x = int32_t(bomb_at[i].x);
-		ppu.sprites[i+num_fish+num_whale+1].y = int32_t(bomb_at[i].y);
-		ppu.sprites[i+num_fish+num_whale+1].index = BOMB_TILE_IDX;
-		ppu.sprites[i+num_fish+num_whale+1].attributes = BOMB_PALETTE_IDX;
-	}
+	//with fixed-size update steps, draw positions part way between the previous and current step:
+	// (things that were removed -- y == 240 -- stay off-screen)
+	auto interpolate = [this](glm::vec2 const &prev_at, glm::vec2 const &at) -> glm::vec2 {
+		if (at.y == 240) return at;
+		return prev_at + (at - prev_at) * tick_alpha;
+	};
 
-	constexpr int SCORE_DISPLAY_WIDTH = 3;
-	int score_sprites_begin = num_fish + num_whale + num_bomb + 1;
-	constexpr std::array<uint8_t, 10> NUMBERS_TILE_IDX = {
-		ZERO_TILE_IDX,
-		ONE_TILE_IDX,
-		TWO_TILE_IDX,
-		THREE_TILE_IDX,
-		FOUR_TILE_IDX,
-		FIVE_TILE_IDX,
-		SIX_TILE_IDX,
-		SEVEN_TILE_IDX,
-		EIGHT_TILE_IDX,
-		NINE_TILE_IDX
+	//sprites are requested from the allocator, which decides which ppu.sprites slot each gets:
+	// (HUD and the player's boomerang always show; if more is asked for than fits, the rest take turns)
+	sprites.begin();
+	// (resources with the same pixels share a tile, so each comes with flip bits saying how to show it)
+	auto request = [this](glm::vec2 const &at, assets::Sprite const &resource, uint8_t priority) {
+		//off-screen things don't need a slot (and converting a position outside [0,256) to uint8_t isn't defined):
+		if (!(at.x >= 0.0f && at.x < 256.0f && at.y >= 0.0f && at.y < 240.0f)) return;
+		PPU466::Sprite sprite;
+		sprite.x = uint8_t(at.x);
+		sprite.y = uint8_t(at.y);
+		sprite.index = resource.index();
+		sprite.attributes = resource.attributes();
+		sprites.request(sprite, priority);
 	};
-	constexpr std::array<uint8_t, 10> NUMBERS_PALETTE_IDX = {
-		ZERO_PALETTE_IDX,
-		ONE_PALETTE_IDX,
-		TWO_PALETTE_IDX,
-		THREE_PALETTE_IDX,
-		FOUR_PALETTE_IDX,
-		FIVE_PALETTE_IDX,
-		SIX_PALETTE_IDX,
-		SEVEN_PALETTE_IDX,
-		EIGHT_PALETTE_IDX,
-		NINE_PALETTE_IDX
+	auto request_boomerang = [&request](glm::vec2 const &at, bool faces_left, uint8_t priority) {
+		if (faces_left) {
+			request(at, assets::sprites::boomerang_left, priority);
+		} else {
+			request(at, assets::sprites::boomerang_right, priority);
+		}
+	};
+
+	constexpr std::array<assets::Sprite, 10> NUMBERS = {
+		assets::sprites::zero,
+		assets::sprites::one,
+		assets::sprites::two,
+		assets::sprites::three,
+		assets::sprites::four,
+		assets::sprites::five,
+		assets::sprites::six,
+		assets::sprites::seven,
+		assets::sprites::eight,
+		assets::sprites::nine
 	};
+
+	//score (top right):
 	{
+		constexpr int SCORE_DISPLAY_WIDTH = 3;
 		std::array<int, 3> score_separate_digits;
-		if (score >= 1000) {
+		if (game.score >= 1000) {
 			score_separate_digits = {9, 9, 9};
 		} else {
-			score_separate_digits = {(score / 100) % 10, (score / 10) % 10, score % 10};
+			score_separate_digits = {(game.score / 100) % 10, (game.score / 10) % 10, game.score % 10};
 		}
 
 		for (int i = 0; i < SCORE_DISPLAY_WIDTH; i++) {
-			ppu.sprites[score_sprites_begin + i].x = 255 - 8 * 3 + i * 8;
-			ppu.sprites[score_sprites_begin + i].y = 239 - 8;
-			ppu.sprites[score_sprites_begin + i].index = NUMBERS_TILE_IDX.at(score_separate_digits.at(i));
-			ppu.sprites[score_sprites_begin + i].attributes = NUMBERS_PALETTE_IDX.at(score_separate_digits.at(i));
+			int digit = score_separate_digits.at(i);
+			request(glm::vec2(255 - 8 * 3 + i * 8, 239 - 8), NUMBERS.at(digit), SpriteAllocator::Always);
 		}
 	}
 
-	int time_sprites_begin = score_sprites_begin + 3;
-	std::array<int,2> time_digits = {(int)time_remain/10, (int)time_remain%10};
-
+	//time (top left):
+	std::array<int,2> time_digits = {(int)game.time_remain/10, (int)game.time_remain%10};
 	for(int i = 0; i<2;i++){
-		ppu.sprites[i+time_sprites_begin].x = 8*(i+1);
-		ppu.sprites[i+time_sprites_begin].y =239-8;
-		ppu.sprites[i+time_sprites_begin].index = NUMBERS_TILE_IDX[time_digits[i]];
-		ppu.sprites[i+time_sprites_begin].attributes = NUMBERS_PALETTE_IDX[time_digits[i]];
+		request(glm::vec2(8*(i+1), 239-8), NUMBERS[time_digits[i]], SpriteAllocator::Always);
 	}
 
-	
+	//player sprite(s):
+	// the first boomerang in play (or the idle one in the player's hand) always shows,
+	// any further boomerangs (only when game.boomerang_limit > 1) get whatever slots are left.
+	bool first_boomerang = true;
+	for (uint32_t b = 0; b < BoomerangPool::Capacity; ++b) {
+		if (game.boomerangs.state[b] == BoomerangPool::BoomerangState::INACTIVE) continue;
+		request_boomerang(interpolate(game.boomerangs.prev_at[b], game.boomerangs.at[b]), game.boomerang_faces_left(b),
+			(first_boomerang ? SpriteAllocator::Always : SpriteAllocator::Low));
+		first_boomerang = false;
+	}
+	if (first_boomerang) {
+		request_boomerang(game.boomerang_hand_at, false, SpriteAllocator::Always);
+	}
+
+	//target sprites:
+	// (bombs matter most -- hitting one costs points -- so they are the last to flicker)
+	for (uint32_t i = 0; i < game.bomb.count; i++){
+		request(interpolate(game.bomb.prev_at[i], game.bomb.at[i]), assets::sprites::bomb, SpriteAllocator::High);
+	}
+	for (uint32_t i = 0; i < game.whale.count; i++){
+		request(interpolate(game.whale.prev_at[i], game.whale.at[i]), assets::sprites::whale, SpriteAllocator::Normal + 1);
+	}
+	for (uint32_t i = 0; i < game.fish.count; i++){
+		request(interpolate(game.fish.prev_at[i], game.fish.at[i]), assets::sprites::fish, SpriteAllocator::Normal);
+	}
+
+	sprites.finish(&ppu.sprites);
+
+	if (overflow_report_limit) check_scanline_overflow();
+
 	//--- actually draw ---
+	if (checksum_log.is_open()) {
+		checksum_log << updates << ' ' << std::hex << game.checksum() << ' ' << ppu.checksum() << std::dec << '\n';
+	}
+
 	ppu.draw(drawable_size);
 }
@@ -1,8 +1,13 @@
 #include "PPU466.hpp"
 #include "Mode.hpp"
+#include "GameState.hpp"
+#include "Replay.hpp"
+#include "RewindBuffer.hpp"
+#include "Snapshot.hpp"
+#include "SpriteAllocator.hpp"
 #include "data_path.hpp"
 #include "read_write_chunk.hpp"
-#include "assets_res.h"
+#include "assets_embedded.hpp"
 
 #include <iostream>
 #include <fstream>
@@ -14,64 +19,75 @@
 
 struct PlayMode : Mode {
 	PlayMode();
+	//(the default constructor loads the tile table and passes it here:)
+	PlayMode(std::vector<PPU466::Tile> const &tiles);
 	virtual ~PlayMode();
 
 	//functions called by main loop:
 	virtual bool handle_event(SDL_Event const &, glm::uvec2 const &window_size) override;
 	virtual void update(float elapsed) override;
 	virtual void draw(glm::uvec2 const &drawable_size) override;
-	void update_target(std::vector<glm::vec2>& at, std::vector<glm::vec2>& velocity, std::vector<bool>& active, uint8_t num, float elapsed);
 
 	//----- game state -----
-	// time and score
-	int score = 0;
-	double time_remain = 60;
-	bool game_stop = false;
-
-	//input tracking:
-	struct Button {
-		uint8_t downs = 0;
-		uint8_t pressed = 0;
-	} space_key;
+	// (score, time, input, boomerangs, and targets; see GameState.hpp)
+	GameState game;
+
+	//pass input to the game (and to the recording, if there is one):
+	void game_input(GameState::InputEvent evt);
+
+	//----- recording -----
+	//record every input and update to 'filename' (written when PlayMode is destroyed):
+	// (call before the first update)
+	void start_recording(std::string const &filename);
+	std::string recording_filename; //empty if not recording
+	Replay recording;
+
+	//----- checksum log -----
+	//log game and PPU checksums for every drawn frame (for comparing runs and builds):
+	void start_checksum_log(std::string const &filename);
+	std::ofstream checksum_log; //(not open if not logging)
+	uint32_t updates = 0; //updates so far
+
+	//----- scanline overflow report -----
+	//check every drawn frame against a limit of overflow_report_limit sprites per scanline (0 = don't check),
+	// mentioning each streak of frames that would overflow and summing up at exit:
+	// (this only reports; ppu.sprites_per_scanline is what actually enforces a limit)
+	uint32_t overflow_report_limit = 0;
+	void check_scanline_overflow();
+	PPU466::ScanlineEvaluation overflow_evaluation;
+	bool overflowing = false; //did the last checked frame overflow?
+	uint32_t overflow_frames_checked = 0;
+	uint32_t overflow_frames = 0;
+	uint32_t overflow_streaks = 0;
+	uint32_t overflow_busiest_count = 0; //most sprites seen on one scanline
+
+	//----- snapshots -----
+	//with a snapshot file set, F5 saves a snapshot of the session there and F9 loads it back:
+	// (loading is not allowed while recording -- replays only hold play from the start)
+	std::string snapshot_filename; //empty if no snapshot file
+	void save_snapshot(std::string const &filename) const;
+	void load_snapshot(std::string const &filename); //throws on error
 
 	//some weird background animation:
 	float background_fade = 0.0f;
 
-	//boomerang
-	glm::vec2 boomerang_at = glm::vec2(0.0f, 128.0f);
-	double boomerang_vec_x = 0.0;
-	enum class BoomerangState { INACTIVE, HOLDING, FLYING };
-	BoomerangState boomerang_state = BoomerangState::INACTIVE;
-	double boomerang_holding_time = 0.0; // only used when boomerang == HOLDING
-	static constexpr double BOOMERANG_INIT_SPEED_COEFFICIENT = 300;
-	static constexpr double BOOMERANG_ACCELERATION = 100;
-	const double BOOMERANG_MAX_SPEED = sqrt(256 * 1.95 * BOOMERANG_ACCELERATION);
-
-	//fish
-	std::vector<glm::vec2> fish_at;
-	std::vector<glm::vec2> fish_velocity;
-	std::vector<bool> fish_active;
-
-	uint8_t num_fish = 10;
-
-	//whale
-	std::vector<glm::vec2> whale_at;
-	std::vector<glm::vec2> whale_velocity;
-	std::vector<bool> whale_active;
-
-	uint8_t num_whale = 2;
-
-	//bomb
-	std::vector<glm::vec2> bomb_at;
-	std::vector<glm::vec2> bomb_velocity;
-	std::vector<bool> bomb_active;
-
-	uint8_t num_bomb = 1;
-
 	//cloud
 	std::vector<uint32_t> cloud_idx;
 	uint8_t num_cloud = 10;
 	//----- drawing handled by PPU466 -----
 
 	PPU466 ppu;
+	SpriteAllocator sprites; //(decides which ppu.sprites slot each thing gets, see draw())
+
+	//----- rewind -----
+	// hold backspace to step back through the last few seconds, one update at a time:
+	// (not while recording -- replays only hold forward play)
+	RewindBuffer rewind; //(captures game, ppu, and background_fade after every update)
+	bool rewinding = false;
+	bool space_held = false; //actual state of the key, to restore after rewinding
+
+	//rewind statistics (reported when a rewind ends):
+	uint32_t rewind_steps = 0;
+	double rewind_seconds_total = 0.0; //time spent in RewindBuffer::step_back
+	double rewind_seconds_max = 0.0;
 };
@@ -0,0 +1,172 @@
+#include "Replay.hpp"
+
+#include "read_write_chunk.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+//---- varint helpers ----
+// (little-endian base 128: seven bits per byte, high bit set on every byte but the last)
+
+static void put_varint(std::vector< uint8_t > *to, uint64_t value) {
+	while (value >= 0x80) {
+		to->emplace_back(uint8_t(value | 0x80));
+		value >>= 7;
+	}
+	to->emplace_back(uint8_t(value));
+}
+
+static bool get_varint(std::vector< uint8_t > const &from, size_t *offset, uint64_t *value) {
+	uint64_t result = 0;
+	for (uint32_t shift = 0; shift < 64; shift += 7) {
+		if (*offset >= from.size()) return false;
+		uint8_t byte = from[(*offset)++];
+		result |= uint64_t(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			*value = result;
+			return true;
+		}
+	}
+	return false;
+}
+
+//zigzag maps small negative numbers to small unsigned numbers: 0,-1,1,-2,... -> 0,1,2,3,...
+static uint64_t zigzag(int64_t value) {
+	return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+static int64_t unzigzag(uint64_t value) {
+	return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+static uint32_t float_bits(float value) {
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+//---- recording ----
+
+void Replay::begin(GameState const &game) {
+	header = Header();
+	header.seed = game.seed;
+	header.boomerang_limit = game.boomerang_limit;
+	header.num_fish = game.tuning.num_fish;
+	header.num_whale = game.tuning.num_whale;
+	header.num_bomb = game.tuning.num_bomb;
+	header.gravity = game.tuning.gravity;
+	header.spawn_chance = game.tuning.spawn_chance;
+	header.fish_points = game.tuning.fish_points;
+	header.whale_points = game.tuning.whale_points;
+	header.bomb_points = game.tuning.bomb_points;
+	header.session_length = game.tuning.session_length;
+
+	frame_data.clear();
+	pending_inputs.clear();
+	last_elapsed_bits = 0;
+}
+
+void Replay::record_input(GameState::InputEvent evt) {
+	pending_inputs.emplace_back(evt);
+}
+
+void Replay::record_frame(float elapsed, GameState const &game) {
+	put_varint(&frame_data, pending_inputs.size());
+	for (auto evt : pending_inputs) {
+		frame_data.emplace_back(uint8_t(evt));
+	}
+	pending_inputs.clear();
+
+	uint32_t bits = float_bits(elapsed);
+	put_varint(&frame_data, zigzag(int64_t(bits) - int64_t(last_elapsed_bits)));
+	last_elapsed_bits = bits;
+
+	uint64_t checksum = game.checksum();
+	for (uint32_t i = 0; i < 8; ++i) {
+		frame_data.emplace_back(uint8_t(checksum >> (8 * i)));
+	}
+
+	header.frames += 1;
+}
+
+//---- playing back ----
+
+GameState Replay::start(std::vector< PPU466::Tile > const &tiles) const {
+	GameState::Tuning tuning;
+	tuning.num_fish = uint8_t(header.num_fish);
+	tuning.num_whale = uint8_t(header.num_whale);
+	tuning.num_bomb = uint8_t(header.num_bomb);
+	tuning.gravity = header.gravity;
+	tuning.spawn_chance = header.spawn_chance;
+	tuning.fish_points = header.fish_points;
+	tuning.whale_points = header.whale_points;
+	tuning.bomb_points = header.bomb_points;
+	tuning.session_length = header.session_length;
+
+	GameState game(tiles, tuning, header.seed);
+	game.boomerang_limit = header.boomerang_limit;
+	return game;
+}
+
+bool Replay::play_frame(Cursor *cursor_, GameState *game_) const {
+	assert(cursor_);
+	assert(game_);
+	Cursor &cursor = *cursor_;
+	GameState &game = *game_;
+
+	uint64_t events;
+	if (!get_varint(frame_data, &cursor.offset, &events)) return false;
+	if (cursor.offset + events > frame_data.size()) return false;
+	for (uint64_t e = 0; e < events; ++e) {
+		game.handle_input(GameState::InputEvent(frame_data[cursor.offset++]));
+	}
+
+	uint64_t delta;
+	if (!get_varint(frame_data, &cursor.offset, &delta)) return false;
+	cursor.elapsed_bits = uint32_t(int64_t(cursor.elapsed_bits) + unzigzag(delta));
+	float elapsed;
+	std::memcpy(&elapsed, &cursor.elapsed_bits, sizeof(elapsed));
+
+	game.update(elapsed);
+
+	if (cursor.offset + 8 > frame_data.size()) return false;
+	uint64_t checksum = 0;
+	for (uint32_t i = 0; i < 8; ++i) {
+		checksum |= uint64_t(frame_data[cursor.offset++]) << (8 * i);
+	}
+	cursor.frame += 1;
+
+	return checksum == game.checksum();
+}
+
+//---- files ----
+
+void Replay::save(std::string const &filename) const {
+	std::ofstream file(filename, std::ios::binary);
+	write_chunk("rph0", std::vector< Header >{ header }, &file);
+	write_chunk("rpf0", frame_data, &file);
+	if (!file) {
+		throw std::runtime_error("Failed to write replay to '" + filename + "'.");
+	}
+}
+
+void Replay::load(std::string const &filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Failed to open replay '" + filename + "'.");
+	}
+	std::vector< Header > headers;
+	read_chunk(file, "rph0", &headers);
+	if (headers.size() != 1) {
+		throw std::runtime_error("Replay '" + filename + "' should have exactly one header.");
+	}
+	if (headers[0].version != Header().version) {
+		throw std::runtime_error("Replay '" + filename + "' has version " + std::to_string(headers[0].version) + ", expected " + std::to_string(Header().version) + ".");
+	}
+	header = headers[0];
+	read_chunk(file, "rpf0", &frame_data);
+
+	pending_inputs.clear();
+	last_elapsed_bits = 0;
+}
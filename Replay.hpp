@@ -0,0 +1,75 @@
+#pragma once
+
+/*
+ * Replay -- a compact recording of one GameState session, for reproducing bugs
+ *  and as a stable, repeatable workload for performance tests.
+ *
+ * A replay stores how the session was started (seed, tuning, boomerang limit) and,
+ *  for every call to GameState::update ("frame"):
+ *   - the input events handled since the previous frame,
+ *   - the 'elapsed' value passed to update (exactly, as float bits),
+ *   - GameState::checksum() after the update.
+ * Re-running the frames against a fresh GameState must reproduce every checksum bit-exactly.
+ *
+ * On disk it is two chunks in the read_write_chunk.hpp format:
+ *  "rph0" -- one Replay::Header
+ *  "rpf0" -- the frame stream, per frame:
+ *      varint   event count, followed by one byte per event (GameState::InputEvent)
+ *      varint   zigzag(float bits of elapsed - float bits of previous frame's elapsed)
+ *      8 bytes  checksum (little endian)
+ */
+
+#include "GameState.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Replay {
+	struct Header {
+		uint32_t version = 2; //(version 2: GameState::checksum became XXH64-based)
+		uint32_t seed = 0;
+		uint32_t boomerang_limit = 1;
+		uint32_t frames = 0;
+		//GameState::Tuning, field by field (so the file has no padding bytes):
+		uint32_t num_fish = 0, num_whale = 0, num_bomb = 0;
+		float gravity = 0.0f;
+		float spawn_chance = 0.0f;
+		int32_t fish_points = 0, whale_points = 0, bomb_points = 0;
+		double session_length = 0.0;
+	};
+	static_assert(sizeof(Header) == 56, "Replay::Header is packed");
+
+	Header header;
+	std::vector< uint8_t > frame_data;
+
+	//---- recording ----
+	//start recording a session that begins with 'game' freshly constructed:
+	void begin(GameState const &game);
+	//note an input event that was passed to game.handle_input():
+	void record_input(GameState::InputEvent evt);
+	//note a call to game.update(elapsed) (call after the update):
+	void record_frame(float elapsed, GameState const &game);
+
+	//---- playing back ----
+	//construct the GameState the recording started from:
+	GameState start(std::vector< PPU466::Tile > const &tiles) const;
+
+	//Cursor walks through the frame stream:
+	struct Cursor {
+		size_t offset = 0;
+		uint32_t frame = 0;
+		uint32_t elapsed_bits = 0;
+	};
+	//apply the next frame's input events to 'game' and run its update:
+	// returns false if the recorded checksum doesn't match (or the stream is malformed).
+	bool play_frame(Cursor *cursor, GameState *game) const;
+
+	//---- files ----
+	void save(std::string const &filename) const;
+	void load(std::string const &filename); //throws on error
+
+	//---- internals ----
+	std::vector< GameState::InputEvent > pending_inputs; //inputs since the last recorded frame
+	uint32_t last_elapsed_bits = 0;
+};
@@ -0,0 +1,243 @@
+#include "RewindBuffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+//---- run-length encoding helpers ----
+
+static uint8_t *put_varint(uint8_t *to, size_t value) {
+	while (value >= 0x80) {
+		*(to++) = uint8_t(value | 0x80);
+		value >>= 7;
+	}
+	*(to++) = uint8_t(value);
+	return to;
+}
+
+static uint8_t const *get_varint(uint8_t const *from, size_t *value) {
+	size_t result = 0;
+	for (uint32_t shift = 0; ; shift += 7) {
+		uint8_t byte = *(from++);
+		result |= size_t(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) break;
+	}
+	*value = result;
+	return from;
+}
+
+static bool same_word(uint8_t const *a, uint8_t const *b) {
+	uint64_t wa, wb;
+	std::memcpy(&wa, a, 8);
+	std::memcpy(&wb, b, 8);
+	return wa == wb;
+}
+
+//literal runs only end at eight or more zero bytes, so there is at most one token per eight bytes of input:
+static size_t max_encoded_size(size_t size) {
+	return size + (size / 8 + 2) * 2 * 10;
+}
+
+//run-length encode (a XOR b) into 'out', returns encoded size:
+// (b == nullptr means "all zeros", which encodes a itself)
+static size_t encode(uint8_t const *a, uint8_t const *b, size_t size, uint8_t *out) {
+	static const uint8_t zeros[8] = { 0,0,0,0,0,0,0,0 };
+	auto equal_word_at = [&](size_t i) {
+		return i + 8 <= size && same_word(a + i, (b ? b + i : zeros));
+	};
+	auto equal_byte_at = [&](size_t i) {
+		return a[i] == (b ? b[i] : 0);
+	};
+
+	uint8_t *at = out;
+	size_t i = 0;
+	while (i < size) {
+		//zero run (mostly a word at a time):
+		size_t zero_end = i;
+		while (zero_end < size) {
+			if (equal_word_at(zero_end)) zero_end += 8;
+			else if (equal_byte_at(zero_end)) zero_end += 1;
+			else break;
+		}
+		if (zero_end == size) break; //(trailing zeros need not be stored)
+
+		//literal run, up to the next zero run that is worth a token:
+		size_t literal_end = zero_end + 1;
+		while (literal_end < size && !equal_word_at(literal_end)) ++literal_end;
+
+		at = put_varint(at, zero_end - i);
+		at = put_varint(at, literal_end - zero_end);
+		for (size_t j = zero_end; j < literal_end; ++j) {
+			*(at++) = a[j] ^ (b ? b[j] : 0);
+		}
+		i = literal_end;
+	}
+	return at - out;
+}
+
+//XOR the run-length encoded bytes 'data' into 'state':
+static void apply(uint8_t const *data, size_t data_size, uint8_t *state, size_t state_size) {
+	uint8_t const *at = data;
+	uint8_t const *end = data + data_size;
+	size_t i = 0;
+	while (at < end) {
+		size_t zeros, literals;
+		at = get_varint(at, &zeros);
+		at = get_varint(at, &literals);
+		i += zeros;
+		assert(i + literals <= state_size);
+		for (size_t j = 0; j < literals; ++j) {
+			state[i + j] ^= at[j];
+		}
+		at += literals;
+		i += literals;
+	}
+	(void)state_size;
+}
+
+//---- RewindBuffer ----
+
+RewindBuffer::RewindBuffer(std::vector< Region > const &regions_, uint32_t max_captures, size_t arena_bytes, uint32_t keyframe_interval_)
+	: regions(regions_), keyframe_interval(std::max(1U, keyframe_interval_)) {
+	size_t total = 0;
+	for (auto const &region : regions) total += region.size;
+
+	if (max_captures < 2) {
+		throw std::runtime_error("RewindBuffer needs room for at least two captures.");
+	}
+	if (arena_bytes < max_encoded_size(total)) {
+		throw std::runtime_error("RewindBuffer arena of " + std::to_string(arena_bytes) + " bytes can't hold a keyframe of a " + std::to_string(total) + " byte state.");
+	}
+
+	captures.resize(max_captures);
+	arena.resize(arena_bytes);
+	latest.resize(total);
+	current.resize(total);
+	encoded.resize(max_encoded_size(total));
+}
+
+void RewindBuffer::gather(uint8_t *to) const {
+	for (auto const &region : regions) {
+		std::memcpy(to, region.data, region.size);
+		to += region.size;
+	}
+}
+
+void RewindBuffer::scatter(uint8_t const *from) {
+	for (auto const &region : regions) {
+		std::memcpy(region.data, from, region.size);
+		from += region.size;
+	}
+}
+
+void RewindBuffer::clear() {
+	first = 0;
+	count = 0;
+	since_keyframe = 0;
+}
+
+size_t RewindBuffer::bytes_used() const {
+	size_t total = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		total += captures[(first + i) % captures.size()].size;
+	}
+	return total;
+}
+
+void RewindBuffer::drop_oldest_keyframe() {
+	assert(count > 0 && capture(0).keyframe);
+	do {
+		first = (first + 1) % captures.size();
+		count -= 1;
+	} while (count > 0 && !capture(0).keyframe);
+	if (count == 0) clear();
+}
+
+bool RewindBuffer::place(uint32_t size, size_t *offset) {
+	assert(size > 0 && size <= arena.size());
+	while (count > 0) {
+		//empty captures (unchanged state) have no bytes in the arena, so only the others bound the space in use:
+		// (an empty capture's offset could be anywhere -- e.g., equal to tail when the arena is full -- and would
+		//  make a full arena look empty)
+		uint32_t oldest = 0;
+		while (oldest < count && capture(oldest).size == 0) ++oldest;
+		if (oldest == count) break; //(nothing in the arena)
+		uint32_t newest_stored = count - 1;
+		while (capture(newest_stored).size == 0) --newest_stored;
+
+		size_t tail = capture(oldest).offset;
+		Capture const &newest = capture(newest_stored);
+		size_t head = newest.offset + newest.size;
+		if (newest.offset >= tail) {
+			//captures are in [tail, head); free space is after head, then before tail:
+			if (head + size <= arena.size()) {
+				*offset = head;
+				return true;
+			}
+			if (size <= tail) {
+				*offset = 0;
+				return true;
+			}
+		} else {
+			//captures have wrapped around; free space is [head, tail):
+			if (head + size <= tail) {
+				*offset = head;
+				return true;
+			}
+		}
+		drop_oldest_keyframe();
+	}
+	*offset = 0;
+	return count > 0; //(false if it had to drop everything)
+}
+
+void RewindBuffer::push() {
+	if (count == captures.size()) drop_oldest_keyframe();
+
+	gather(current.data());
+
+	bool keyframe = (count == 0 || since_keyframe + 1 >= keyframe_interval);
+	uint32_t size = uint32_t(encode(current.data(), (keyframe ? nullptr : latest.data()), current.size(), encoded.data()));
+
+	//(a capture that encodes to nothing -- nothing changed -- is recorded without taking any arena space)
+	size_t offset = 0;
+	if (size > 0 && !place(size, &offset) && !keyframe) {
+		//making room dropped the capture the delta was against, so store a keyframe instead:
+		keyframe = true;
+		size = uint32_t(encode(current.data(), nullptr, current.size(), encoded.data()));
+		//(the arena is empty now, so the keyframe goes at offset 0)
+	}
+	std::memcpy(arena.data() + offset, encoded.data(), size);
+
+	captures[(first + count) % captures.size()] = Capture{ offset, size, keyframe };
+	count += 1;
+	since_keyframe = (keyframe ? 0 : since_keyframe + 1);
+
+	std::swap(latest, current);
+}
+
+bool RewindBuffer::step_back() {
+	if (count < 2) return false;
+
+	Capture const &newest = capture(count - 1);
+	if (!newest.keyframe) {
+		//XOR'ing the delta back out gives the previous state:
+		apply(arena.data() + newest.offset, newest.size, latest.data(), latest.size());
+		since_keyframe -= 1;
+	} else {
+		//rebuild the previous state from the keyframe before it:
+		uint32_t k = count - 2;
+		while (!capture(k).keyframe) --k; //(the oldest capture is always a keyframe)
+		std::memset(latest.data(), 0, latest.size());
+		for (uint32_t i = k; i <= count - 2; ++i) {
+			apply(arena.data() + capture(i).offset, capture(i).size, latest.data(), latest.size());
+		}
+		since_keyframe = count - 2 - k;
+	}
+	count -= 1;
+
+	scatter(latest.data());
+	return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+/*
+ * RewindBuffer -- the last few seconds of a game's state, in a fixed memory budget.
+ *
+ * The state is a list of plain-data regions (e.g., a GameState and a PPU466) that
+ *  are captured together once per update with push(), and can be stepped back
+ *  through one update at a time with step_back().
+ *
+ * Captures are stored in a ring arena (allocated once, in the constructor) as:
+ *  - keyframes, every 'keyframe_interval' captures: the whole state, run-length encoded
+ *  - deltas, in between: (this capture XOR the previous capture), run-length encoded
+ * Most of the state (tile table, background, unused pool slots) doesn't change
+ *  from update to update, so deltas are mostly zero runs and end up tiny.
+ *
+ * Because XOR undoes itself, stepping back over a delta is one decode applied to the
+ *  current state; stepping back over a keyframe decodes the previous keyframe and
+ *  the (at most keyframe_interval - 1) deltas after it.
+ *
+ * When the arena or the capture table fills up, the oldest keyframe and its deltas
+ *  are dropped together, so every capture left can still be rebuilt.
+ *
+ * Run-length encoding (of a keyframe, or of XOR'd bytes) is a list of:
+ *   varint   number of zero bytes
+ *   varint   number of literal bytes
+ *   bytes    the literal bytes
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct RewindBuffer {
+	//a piece of state to capture (must stay valid, and the same size, for the life of the buffer):
+	struct Region {
+		void *data;
+		size_t size;
+	};
+
+	//'max_captures' limits how much history is kept (e.g., seconds * updates per second);
+	//'arena_bytes' is the memory budget for the encoded captures:
+	RewindBuffer(std::vector< Region > const &regions, uint32_t max_captures, size_t arena_bytes, uint32_t keyframe_interval = 60);
+
+	//capture the current contents of the regions:
+	void push();
+
+	//restore the regions to the capture before the most recent one (and forget the most recent one):
+	// returns false (and leaves the regions alone) if there isn't an earlier capture.
+	bool step_back();
+
+	//drop all captures:
+	void clear();
+
+	//number of captures held:
+	uint32_t size() const { return count; }
+	//arena bytes used by the captures held:
+	size_t bytes_used() const;
+	//total size of the regions (the size of one uncompressed capture):
+	size_t state_size() const { return latest.size(); }
+
+	//----- internals -----
+	std::vector< Region > regions;
+	uint32_t keyframe_interval;
+
+	//captures, oldest first, in a ring of descriptors:
+	struct Capture {
+		size_t offset; //start of the encoded capture in the arena
+		uint32_t size; //size of the encoded capture (0 if nothing changed: then it takes no arena space, and offset means nothing)
+		bool keyframe;
+	};
+	std::vector< Capture > captures;
+	uint32_t first = 0; //index of oldest capture in 'captures'
+	uint32_t count = 0; //number of captures held
+	uint32_t since_keyframe = 0; //captures pushed since the most recent keyframe
+
+	std::vector< uint8_t > arena;
+
+	std::vector< uint8_t > latest; //the state as of the most recent capture
+	std::vector< uint8_t > current; //the state being captured by push()
+	std::vector< uint8_t > encoded; //encoding workspace
+
+	Capture &capture(uint32_t i) { return captures[(first + i) % captures.size()]; } //i-th oldest capture
+	void drop_oldest_keyframe();
+	bool place(uint32_t size, size_t *offset); //find arena space for a new capture (dropping old ones as needed)
+	void gather(uint8_t *to) const; //copy the regions into 'to'
+	void scatter(uint8_t const *from); //copy 'from' into the regions
+};
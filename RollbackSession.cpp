@@ -0,0 +1,107 @@
+#include "RollbackSession.hpp"
+
+#include <cassert>
+
+VersusState::VersusState(std::vector< PPU466::Tile > const &tiles, GameState::Tuning const &tuning, uint32_t seed)
+	: players{ GameState(tiles, tuning, seed), GameState(tiles, tuning, seed) } {
+}
+
+void VersusState::update(Inputs inputs, float elapsed) {
+	for (uint32_t p = 0; p < players.size(); ++p) {
+		bool pressed = (inputs >> p) & 1;
+		if (pressed != bool(players[p].space_key.pressed)) {
+			players[p].handle_input(pressed ? GameState::InputEvent::SpaceDown : GameState::InputEvent::SpaceUp);
+		}
+		players[p].update(elapsed);
+	}
+}
+
+uint64_t VersusState::checksum() const {
+	uint64_t a = players[0].checksum();
+	uint64_t b = players[1].checksum();
+	return a ^ (b + 0x9e3779b97f4a7c15ULL + (a << 6) + (a >> 2));
+}
+
+RollbackSession::RollbackSession(VersusState const &start, uint32_t local_player_, float elapsed_per_frame)
+	: state(start), local_player(local_player_), elapsed(elapsed_per_frame), saved(History, start) {
+	assert(local_player < 2);
+	local_input.fill(false);
+	remote_input.fill(false);
+}
+
+VersusState::Inputs RollbackSession::inputs_for(uint32_t f) const {
+	uint32_t remote_player = 1 - local_player;
+	return VersusState::Inputs(
+		  (local_input[f % History] ? (1 << local_player) : 0)
+		| (remote_input[f % History] ? (1 << remote_player) : 0)
+	);
+}
+
+void RollbackSession::resolve() {
+	if (rollback_from == ~0U) return;
+	assert(rollback_from < frame && frame - rollback_from <= MaxRollback);
+
+	state = saved[rollback_from % History];
+	for (uint32_t f = rollback_from; f < frame; ++f) {
+		if (f != rollback_from) saved[f % History] = state;
+		if (f >= remote_known) remote_input[f % History] = last_remote; //re-predict with the newest input
+		state.update(inputs_for(f), elapsed);
+	}
+
+	stats.rollbacks += 1;
+	stats.frames_resimulated += frame - rollback_from;
+	stats.deepest_rollback = std::max(stats.deepest_rollback, frame - rollback_from);
+	rollback_from = ~0U;
+}
+
+bool RollbackSession::advance(bool local_pressed) {
+	resolve();
+
+	if (frame >= remote_known + MaxRollback) {
+		stats.stalls += 1;
+		return false;
+	}
+
+	uint32_t i = frame % History;
+	saved[i] = state;
+	local_input[i] = local_pressed;
+	if (frame >= remote_known) remote_input[i] = last_remote; //predict: remote player keeps doing what they were doing
+
+	state.update(inputs_for(frame), elapsed);
+	frame += 1;
+	return true;
+}
+
+RollbackSession::Packet RollbackSession::make_packet() const {
+	Packet packet;
+	packet.first_frame = peer_ack;
+	packet.count = std::min< uint32_t >(frame - peer_ack, 64);
+	assert(frame - peer_ack <= History); //(the stall rule keeps the peers close together)
+	packet.ack = remote_known;
+	for (uint32_t b = 0; b < packet.count; ++b) {
+		if (local_input[(packet.first_frame + b) % History]) packet.inputs |= (1ULL << b);
+	}
+	return packet;
+}
+
+void RollbackSession::receive_packet(Packet const &packet) {
+	if (packet.magic != Packet().magic || packet.count > 64) return; //not one of ours
+
+	peer_ack = std::max(peer_ack, std::min(packet.ack, frame));
+
+	for (uint32_t b = 0; b < packet.count; ++b) {
+		uint32_t f = packet.first_frame + b;
+		if (f < remote_known) continue; //already have it
+		if (f > remote_known || f >= frame + History - MaxRollback) break; //gap (reordered packet); it will be resent
+
+		bool pressed = (packet.inputs >> b) & 1;
+		uint32_t i = f % History;
+		if (f < frame && remote_input[i] != pressed) {
+			//already simulated frame f with the wrong guess:
+			rollback_from = std::min(rollback_from, f);
+		}
+		remote_input[i] = pressed;
+		last_remote = pressed;
+		remote_known += 1;
+	}
+}
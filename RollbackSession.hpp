@@ -0,0 +1,107 @@
+#pragma once
+
+/*
+ * RollbackSession -- two-player versus over an unreliable connection, using rollback.
+ *
+ * Both peers run the same deterministic VersusState, one fixed-size step per frame.
+ * Each frame, a peer knows its own input right away, but the other peer's input
+ *  arrives some frames later; instead of waiting for it, the peer predicts it
+ *  (same as the last input it knows about) and keeps going.
+ * When the real input arrives and doesn't match the prediction, the peer rolls back:
+ *  it restores the state saved at the start of the mispredicted frame and re-simulates
+ *  up to the present with the corrected inputs.
+ *
+ * A peer never gets more than MaxRollback frames ahead of the last frame it knows the
+ *  other peer's input for; if it would, it stalls (advance() returns false) until inputs arrive.
+ *
+ * RollbackSession doesn't do any networking itself: call make_packet() / receive_packet()
+ *  and move the packets however you like (netplay.cpp uses UdpSocket).
+ */
+
+#include "GameState.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+//VersusState: two players, each with their own board, started from the same seed:
+// (so both boards see the same targets until the players' throws make them differ; high score wins)
+struct VersusState {
+	VersusState(std::vector< PPU466::Tile > const &tiles, GameState::Tuning const &tuning, uint32_t seed);
+
+	//inputs for one frame: bit 'p' is set if player 'p' is holding space
+	typedef uint8_t Inputs;
+
+	//apply a frame's inputs, then advance both boards:
+	void update(Inputs inputs, float elapsed);
+
+	uint64_t checksum() const;
+
+	std::array< GameState, 2 > players;
+};
+
+struct RollbackSession {
+	enum : uint32_t {
+		MaxRollback = 8, //at most this many frames are ever re-simulated
+		History = 32, //frames of saved state and inputs kept (must be more than MaxRollback)
+	};
+	static_assert(History > MaxRollback, "enough history to roll back");
+
+	RollbackSession(VersusState const &start, uint32_t local_player, float elapsed_per_frame);
+
+	//----- simulation -----
+	//advance one frame with the local player holding space (or not):
+	// returns false without advancing if that would get too far ahead of the remote player's inputs.
+	bool advance(bool local_pressed);
+
+	//the current (possibly predicted) state, after 'frame' updates:
+	VersusState state;
+	uint32_t frame = 0;
+
+	//frames [0, confirmed()) have been simulated with real inputs from both players:
+	uint32_t confirmed() const { return std::min(frame, remote_known); }
+
+	//----- networking -----
+	struct Packet {
+		uint32_t magic = 0x72627631; //"rbv1"
+		uint32_t first_frame = 0; //frame of the first input in 'inputs'
+		uint32_t count = 0; //number of inputs in 'inputs' (at most 64)
+		uint32_t ack = 0; //sender has the receiver's inputs for frames [0, ack)
+		uint64_t inputs = 0; //bit 'i' is the sender's input for frame first_frame + i
+	};
+	static_assert(sizeof(Packet) == 24, "Packet is packed");
+
+	//the local inputs the other peer hasn't acknowledged yet:
+	// (everything unacknowledged is resent every time, so lost packets don't need special handling)
+	Packet make_packet() const;
+	//take in the remote inputs from a packet (may trigger a rollback on the next advance()):
+	void receive_packet(Packet const &packet);
+
+	//roll back and re-simulate now if a misprediction is pending (advance() also does this):
+	void resolve();
+
+	//----- statistics -----
+	struct Stats {
+		uint32_t rollbacks = 0; //number of times a misprediction was corrected
+		uint64_t frames_resimulated = 0;
+		uint32_t deepest_rollback = 0; //most frames re-simulated at once
+		uint32_t stalls = 0; //calls to advance() that had to wait
+	} stats;
+
+	//----- internals -----
+	uint32_t local_player;
+	float elapsed;
+
+	//per frame f (stored at index f % History):
+	std::vector< VersusState > saved; //state at the start of frame f (History of them, allocated once)
+	std::array< bool, History > local_input; //local player's input for frame f
+	std::array< bool, History > remote_input; //remote player's input as used (predicted or real) for frame f
+
+	uint32_t remote_known = 0; //remote inputs are known for frames [0, remote_known)
+	bool last_remote = false; //remote input for frame remote_known - 1 (the prediction for later frames)
+	uint32_t peer_ack = 0; //peer has our inputs for frames [0, peer_ack)
+	uint32_t rollback_from = ~0U; //earliest mispredicted frame (~0U if none)
+
+	VersusState::Inputs inputs_for(uint32_t f) const;
+};
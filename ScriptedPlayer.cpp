@@ -0,0 +1,27 @@
+#include "ScriptedPlayer.hpp"
+
+#include "Replay.hpp"
+
+ScriptedPlayer::ScriptedPlayer(float min_hold_, float max_hold_, uint32_t seed) : min_hold(min_hold_), max_hold(max_hold_), rng(seed) {
+}
+
+bool ScriptedPlayer::next(float elapsed) {
+	if (pressed) {
+		held_for += elapsed;
+		if (held_for >= hold) pressed = false;
+	} else {
+		pressed = true;
+		held_for = 0.0f;
+		hold = min_hold + (max_hold - min_hold) * (rng() / float(rng.max()));
+	}
+	return pressed;
+}
+
+void ScriptedPlayer::drive(GameState &game, float elapsed, Replay *recording) {
+	bool want = next(elapsed);
+	if (want != bool(game.space_key.pressed)) {
+		GameState::InputEvent evt = (want ? GameState::InputEvent::SpaceDown : GameState::InputEvent::SpaceUp);
+		game.handle_input(evt);
+		if (recording) recording->record_input(evt);
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+/*
+ * ScriptedPlayer -- a stand-in for a human, for headless tools (sim_bench, monte_carlo, ...).
+ *
+ * It plays the only way the game can be played: hold space for a while, let go, repeat.
+ * Each hold lasts a random time in [min_hold, max_hold] seconds (a fixed time if they are equal);
+ *  the choice comes from the player's own generator, so a seeded player is repeatable.
+ */
+
+#include "GameState.hpp"
+
+#include <random>
+
+struct Replay;
+
+struct ScriptedPlayer {
+	ScriptedPlayer(float min_hold, float max_hold, uint32_t seed);
+
+	//press or release space on 'game'; call once before each game.update(elapsed):
+	// (if 'recording' is given, the input events are also noted there)
+	void drive(GameState &game, float elapsed, Replay *recording = nullptr);
+
+	//or, without a GameState, just decide whether space is held for the next update:
+	bool next(float elapsed);
+
+	float min_hold, max_hold;
+	float hold = 0.0f; //length of the current hold
+	float held_for = 0.0f; //how long space has been held so far
+	bool pressed = false; //is space held?
+	std::mt19937 rng;
+};
@@ -0,0 +1,64 @@
+#include "Snapshot.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+Snapshot::Snapshot(GameState const &game_, PPU466 const &ppu_, float background_fade_) : game(game_), ppu(ppu_), background_fade(background_fade_) {
+	header.size = uint32_t(sizeof(Snapshot) - 8);
+}
+
+void Snapshot::restore(GameState *game_, PPU466 *ppu_, float *background_fade_) const {
+	assert(game_);
+	assert(ppu_);
+	assert(background_fade_);
+	*game_ = game;
+	*ppu_ = ppu;
+	ppu_->mark_background_dirty(); //(the saved dirty rows say nothing about what is on the GPU now)
+	*background_fade_ = background_fade;
+}
+
+void Snapshot::save(std::string const &filename) const {
+	std::ofstream file(filename, std::ios::binary);
+	file.write(reinterpret_cast< char const * >(this), sizeof(*this));
+	if (!file) {
+		throw std::runtime_error("Failed to write snapshot to '" + filename + "'.");
+	}
+}
+
+void Snapshot::load(std::string const &filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Failed to open snapshot '" + filename + "'.");
+	}
+
+	Header expected;
+	expected.size = header.size;
+
+	Header loaded;
+	if (!file.read(reinterpret_cast< char * >(&loaded), sizeof(loaded))) {
+		throw std::runtime_error("Failed to read snapshot header from '" + filename + "'.");
+	}
+	if (std::memcmp(loaded.magic, expected.magic, 4) != 0) {
+		throw std::runtime_error("'" + filename + "' isn't a snapshot.");
+	}
+	if (loaded.version != expected.version) {
+		throw std::runtime_error("Snapshot '" + filename + "' has version " + std::to_string(loaded.version) + ", expected " + std::to_string(expected.version) + ".");
+	}
+	if (loaded.byte_order != expected.byte_order
+	 || loaded.size != expected.size
+	 || loaded.game_size != expected.game_size
+	 || loaded.ppu_size != expected.ppu_size) {
+		throw std::runtime_error("Snapshot '" + filename + "' was saved by a build with a different memory layout.");
+	}
+
+	//read the rest straight into place:
+	// (read into a copy first, so a short file doesn't leave this snapshot half-overwritten)
+	Snapshot temp = *this;
+	char *rest = reinterpret_cast< char * >(&temp) + sizeof(Header);
+	if (!file.read(rest, sizeof(Snapshot) - sizeof(Header))) {
+		throw std::runtime_error("Snapshot '" + filename + "' is truncated.");
+	}
+	*this = temp;
+}
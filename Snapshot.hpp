@@ -0,0 +1,52 @@
+#pragma once
+
+/*
+ * Snapshot -- a complete copy of a PlayMode session's state:
+ *  the GameState (score, time, input, boomerang pool, target pools, generator state)
+ *  and the PPU466 (palette table, tile table, background, sprites), plus background_fade.
+ *
+ * Everything involved is plain data, so a Snapshot is one flat struct:
+ *  taking or restoring one is a memcpy, saving one is a single write of the struct,
+ *  and loading one reads straight into the struct (a mapped file could be used in place).
+ *
+ * The file is the struct's bytes, starting with a header in the style of read_write_chunk.hpp:
+ *  |sn|p0|..|..| <-- magic number "snp0"
+ *  |sz|sz|sz|sz| <-- size of the rest of the file
+ *  version, byte order, and struct sizes -- a snapshot only loads into a build with the same layout
+ *  the GameState, PPU466, and background_fade, as laid out in memory
+ */
+
+#include "GameState.hpp"
+#include "PPU466.hpp"
+
+#include <string>
+#include <type_traits>
+
+struct Snapshot {
+	struct Header {
+		char magic[4] = {'s', 'n', 'p', '0'};
+		uint32_t size = 0; //bytes after 'magic' and 'size' (set by the Snapshot constructor)
+		uint32_t version = 1;
+		uint32_t byte_order = 0x01020304;
+		uint32_t game_size = sizeof(GameState);
+		uint32_t ppu_size = sizeof(PPU466);
+	};
+	static_assert(sizeof(Header) == 24, "Snapshot::Header is packed");
+
+	Header header;
+	GameState game;
+	PPU466 ppu;
+	float background_fade;
+
+	//take a snapshot:
+	Snapshot(GameState const &game, PPU466 const &ppu, float background_fade);
+
+	//copy the snapshot back into live state:
+	void restore(GameState *game, PPU466 *ppu, float *background_fade) const;
+
+	//write to / read from a file:
+	void save(std::string const &filename) const;
+	void load(std::string const &filename); //throws if the file isn't a snapshot from a matching build
+};
+
+static_assert(std::is_trivially_copyable< Snapshot >::value, "Snapshot is plain data");
@@ -0,0 +1,88 @@
+#include "SpriteAllocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+void SpriteAllocator::begin() {
+	count = 0;
+	overflowed = 0;
+}
+
+void SpriteAllocator::request(PPU466::Sprite const &sprite, uint8_t priority_) {
+	if (count == MaxRequests) {
+		overflowed += 1;
+		return;
+	}
+	requested[count] = sprite;
+	priority[count] = priority_;
+	count += 1;
+}
+
+void SpriteAllocator::finish(std::array< PPU466::Sprite, 64 > *sprites_) {
+	assert(sprites_);
+	auto &sprites = *sprites_;
+
+	//sort requests by priority, highest first (counting sort, so order within a level is kept):
+	std::array< uint32_t, 257 > level_begin;
+	level_begin.fill(0);
+	for (uint32_t r = 0; r < count; ++r) {
+		level_begin[255 - priority[r] + 1] += 1;
+	}
+	for (uint32_t l = 1; l < level_begin.size(); ++l) {
+		level_begin[l] += level_begin[l-1];
+	}
+	{
+		std::array< uint32_t, 256 > next;
+		std::copy(level_begin.begin(), level_begin.begin() + 256, next.begin());
+		for (uint32_t r = 0; r < count; ++r) {
+			order[next[255 - priority[r]]++] = uint16_t(r);
+		}
+	}
+
+	//place whole levels while they fit; rotate through the first level that doesn't:
+	// (the PPU draws later slots over earlier ones, so slots are filled from the last one down)
+	uint32_t placed = 0;
+	auto place = [&sprites, &placed](PPU466::Sprite const &sprite) {
+		sprites[Slots - 1 - placed] = sprite;
+		placed += 1;
+	};
+	for (uint32_t l = 0; l < 256 && placed < Slots; ++l) {
+		uint32_t begin = level_begin[l];
+		uint32_t size = level_begin[l+1] - begin;
+		if (size == 0) continue;
+		if (placed + size <= Slots) {
+			for (uint32_t i = 0; i < size; ++i) {
+				place(requested[order[begin + i]]);
+			}
+		} else {
+			//this level gets 'free' slots; give them to a different run of its requests each frame:
+			uint32_t free = Slots - placed;
+			uint32_t start = uint32_t((uint64_t(frame) * free) % size);
+			for (uint32_t i = 0; i < free; ++i) {
+				place(requested[order[begin + (start + i) % size]]);
+			}
+		}
+	}
+	for (uint32_t s = 0; s < Slots - placed; ++s) {
+		sprites[s].y = 240; //off-screen
+	}
+
+	uint32_t total = count + overflowed;
+	stats.frames += 1;
+	stats.requests += total;
+	stats.peak_requests = std::max(stats.peak_requests, total);
+	if (total > Slots) stats.multiplexed_frames += 1;
+	stats.hidden += total - placed;
+
+	frame += 1;
+}
+
+void SpriteAllocator::report(std::ostream &to) const {
+	to << "Sprite slots: " << stats.frames << " frames, "
+	   << (stats.frames ? double(stats.requests) / double(stats.frames) : 0.0) << " requests per frame on average, "
+	   << stats.peak_requests << " at most; "
+	   << stats.multiplexed_frames << " frames had to multiplex ("
+	   << (stats.frames ? 100.0 * double(stats.multiplexed_frames) / double(stats.frames) : 0.0) << "%), hiding "
+	   << stats.hidden << " sprites in total." << std::endl;
+}
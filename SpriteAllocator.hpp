@@ -0,0 +1,63 @@
+#pragma once
+
+/*
+ * SpriteAllocator -- hands out the PPU's 64 sprite slots each frame.
+ *
+ * Instead of writing to fixed ppu.sprites indices, drawing code request()s a sprite
+ *  with a priority (higher is more important), then finish() fills ppu.sprites:
+ *  - if everything fits, every request gets a slot (higher priorities in later slots, so they draw on top);
+ *  - if not, whole priority levels are placed from the top down until one doesn't fit;
+ *    that level's requests take turns in the remaining slots, a different subset each frame
+ *    (the classic NES "flicker" multiplexing), and lower levels are hidden for the frame.
+ * Requests within a level are rotated in the order they were made, so make them in a
+ *  consistent order from frame to frame.
+ *
+ * Statistics about slot pressure are kept as it goes (see Stats).
+ */
+
+#include "PPU466.hpp"
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+
+struct SpriteAllocator {
+	//(some handy priorities; any value 0-255 works)
+	enum Priority : uint8_t {
+		Low = 64,
+		Normal = 128,
+		High = 192,
+		Always = 255, //(still only guaranteed if there are at most 64 of these)
+	};
+
+	//start a new frame:
+	void begin();
+
+	//ask for a sprite this frame:
+	void request(PPU466::Sprite const &sprite, uint8_t priority);
+
+	//assign slots and write them to 'sprites' (unused slots are moved off-screen):
+	void finish(std::array< PPU466::Sprite, 64 > *sprites);
+
+	struct Stats {
+		uint64_t frames = 0;
+		uint64_t requests = 0; //total over all frames
+		uint32_t peak_requests = 0; //most requests in one frame
+		uint64_t multiplexed_frames = 0; //frames that had more requests than slots
+		uint64_t hidden = 0; //total over all frames of requests that didn't get a slot
+	} stats;
+	void report(std::ostream &to) const;
+
+	//----- internals -----
+	enum : uint32_t {
+		Slots = 64,
+		MaxRequests = 1024, //(requests past this are counted as hidden)
+	};
+	std::array< PPU466::Sprite, MaxRequests > requested;
+	std::array< uint8_t, MaxRequests > priority;
+	uint32_t count = 0; //requests this frame
+	uint32_t overflowed = 0; //requests past MaxRequests this frame
+
+	std::array< uint16_t, MaxRequests > order; //requests sorted by priority (highest first, stable)
+	uint32_t frame = 0; //for choosing which requests get turns
+};
@@ -0,0 +1,90 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+ThreadPool::ThreadPool(uint32_t threads_) {
+	uint32_t count = threads_;
+	if (count == 0) count = std::max(1U, std::thread::hardware_concurrency());
+
+	for (uint32_t i = 0; i < count; ++i) {
+		workers.emplace_back(std::make_unique< Worker >());
+	}
+	for (uint32_t i = 0; i < count; ++i) {
+		threads.emplace_back(&ThreadPool::work, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	wait();
+	{
+		std::unique_lock< std::mutex > lock(sleep_mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+
+void ThreadPool::run(Task const &task) {
+	outstanding += 1;
+	{ //count under sleep_mutex so a worker can't miss the wakeup:
+		std::unique_lock< std::mutex > lock(sleep_mutex);
+		queued += 1;
+	}
+	{ //spread tasks round-robin; idle workers will steal if this is uneven:
+		Worker &worker = *workers[next_worker++ % workers.size()];
+		std::unique_lock< std::mutex > lock(worker.mutex);
+		worker.tasks.emplace_back(task);
+	}
+	wake.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock< std::mutex > lock(sleep_mutex);
+	idle.wait(lock, [this](){ return outstanding == 0; });
+}
+
+bool ThreadPool::pop_or_steal(uint32_t index, Task *task) {
+	assert(task);
+	{ //newest task from own queue:
+		Worker &worker = *workers[index];
+		std::unique_lock< std::mutex > lock(worker.mutex);
+		if (!worker.tasks.empty()) {
+			*task = std::move(worker.tasks.back());
+			worker.tasks.pop_back();
+			return true;
+		}
+	}
+	//oldest task from someone else's queue:
+	for (uint32_t offset = 1; offset < workers.size(); ++offset) {
+		Worker &victim = *workers[(index + offset) % workers.size()];
+		std::unique_lock< std::mutex > lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			*task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::work(uint32_t index) {
+	Task task;
+	while (true) {
+		if (pop_or_steal(index, &task)) {
+			queued -= 1;
+			task(index);
+			task = nullptr;
+			if (outstanding.fetch_sub(1) == 1) {
+				std::unique_lock< std::mutex > lock(sleep_mutex);
+				idle.notify_all();
+			}
+		} else {
+			std::unique_lock< std::mutex > lock(sleep_mutex);
+			wake.wait(lock, [this](){ return stopping || queued != 0; });
+			if (stopping && queued == 0) return;
+		}
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ * ThreadPool -- a small work-stealing thread pool for batch tools.
+ *
+ * Each worker thread has its own task queue:
+ *  workers take tasks from the back of their own queue,
+ *  and, when that is empty, steal from the front of other workers' queues.
+ *
+ * Tasks are passed the index of the worker running them (0 .. size()-1),
+ *  which is handy for keeping per-thread scratch buffers.
+ *
+ * Example:
+ *   ThreadPool pool;
+ *   for (uint32_t i = 0; i < jobs.size(); ++i) {
+ *       pool.run([&,i](uint32_t worker){ do_job(jobs[i], scratch[worker]); });
+ *   }
+ *   pool.wait();
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ThreadPool {
+	//'threads' == 0 means "one per hardware thread":
+	explicit ThreadPool(uint32_t threads = 0);
+	~ThreadPool();
+
+	typedef std::function< void(uint32_t worker) > Task;
+
+	//queue a task (tasks are spread over the workers' queues):
+	void run(Task const &task);
+
+	//block until every queued task has finished:
+	void wait();
+
+	//number of worker threads:
+	uint32_t size() const { return uint32_t(workers.size()); }
+
+	//----- internals -----
+	struct Worker {
+		std::mutex mutex;
+		std::deque< Task > tasks;
+	};
+	std::vector< std::unique_ptr< Worker > > workers;
+	std::vector< std::thread > threads;
+
+	bool pop_or_steal(uint32_t worker, Task *task);
+	void work(uint32_t worker);
+
+	std::mutex sleep_mutex;
+	std::condition_variable wake; //<-- signalled when tasks are queued or the pool is stopping
+	std::condition_variable idle; //<-- signalled when the last outstanding task finishes
+	std::atomic< uint64_t > queued{0}; //tasks sitting in queues
+	std::atomic< uint64_t > outstanding{0}; //tasks queued or running
+	std::atomic< uint32_t > next_worker{0};
+	bool stopping = false;
+};
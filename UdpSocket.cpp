@@ -0,0 +1,86 @@
+#include "UdpSocket.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+static sockaddr_in localhost(uint16_t port) {
+	sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	return addr;
+}
+
+UdpSocket::UdpSocket(uint16_t port, Conditions const &conditions_, uint32_t seed) : conditions(conditions_), rng(seed) {
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		throw std::runtime_error(std::string("Failed to create socket: ") + std::strerror(errno));
+	}
+	sockaddr_in addr = localhost(port);
+	if (bind(fd, reinterpret_cast< sockaddr const * >(&addr), sizeof(addr)) != 0) {
+		std::string err = std::strerror(errno);
+		close(fd);
+		throw std::runtime_error("Failed to bind to port " + std::to_string(port) + ": " + err);
+	}
+	int flags = fcntl(fd, F_GETFL, 0);
+	fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+UdpSocket::~UdpSocket() {
+	if (fd >= 0) close(fd);
+}
+
+void UdpSocket::send_now(uint16_t to_port, void const *data, size_t size) {
+	sockaddr_in addr = localhost(to_port);
+	//(a full buffer or an absent peer just loses the packet, which is fine for UDP)
+	sendto(fd, data, size, 0, reinterpret_cast< sockaddr const * >(&addr), sizeof(addr));
+}
+
+void UdpSocket::flush() {
+	Clock::time_point now = Clock::now();
+	//(send everything that's due; with jitter, packets may leave in a different order than they were sent)
+	for (auto d = delayed.begin(); d != delayed.end(); ) {
+		if (d->due <= now) {
+			send_now(d->to_port, d->data.data(), d->data.size());
+			d = delayed.erase(d);
+		} else {
+			++d;
+		}
+	}
+}
+
+void UdpSocket::send(uint16_t to_port, void const *data, size_t size) {
+	sent += 1;
+	auto chance = [this]() { return rng() / float(rng.max()); };
+	if (conditions.loss > 0.0f && chance() < conditions.loss) {
+		dropped += 1;
+	} else if (conditions.latency > 0.0f || conditions.jitter > 0.0f) {
+		float delay = conditions.latency + conditions.jitter * chance();
+		uint8_t const *bytes = reinterpret_cast< uint8_t const * >(data);
+		delayed.emplace_back(Delayed{
+			Clock::now() + std::chrono::duration_cast< Clock::duration >(std::chrono::duration< float >(delay)),
+			to_port,
+			std::vector< uint8_t >(bytes, bytes + size)
+		});
+	} else {
+		send_now(to_port, data, size);
+	}
+	flush();
+}
+
+size_t UdpSocket::receive(void *data, size_t size) {
+	flush();
+	ssize_t got = recv(fd, data, size, 0);
+	if (got <= 0) return 0; //(EAGAIN: nothing waiting)
+	received += 1;
+	return size_t(got);
+}
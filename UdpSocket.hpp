@@ -0,0 +1,57 @@
+#pragma once
+
+/*
+ * UdpSocket -- a non-blocking UDP socket bound to a port on localhost,
+ *  with optional simulated network conditions (latency, jitter, packet loss)
+ *  applied to outgoing packets, for testing netplay on one machine.
+ *
+ * (uses POSIX sockets, so -- like asset_pipe_converter -- only built on Linux and macOS)
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <vector>
+
+struct UdpSocket {
+	struct Conditions {
+		float latency = 0.0f; //seconds added to every packet's trip
+		float jitter = 0.0f; //up to this many more seconds, at random (can reorder packets)
+		float loss = 0.0f; //chance that a packet is dropped
+	};
+
+	//bind to 127.0.0.1:port (throws on failure):
+	UdpSocket(uint16_t port, Conditions const &conditions, uint32_t seed);
+	~UdpSocket();
+	UdpSocket(UdpSocket const &) = delete;
+	UdpSocket &operator=(UdpSocket const &) = delete;
+
+	//send a packet to 127.0.0.1:to_port (subject to the simulated conditions):
+	void send(uint16_t to_port, void const *data, size_t size);
+
+	//receive a waiting packet, if there is one:
+	// returns the packet's size (0 if there was nothing waiting; packets larger than 'size' are truncated)
+	size_t receive(void *data, size_t size);
+
+	//actually send any delayed packets that are due (send() and receive() also do this):
+	void flush();
+
+	//----- internals -----
+	int fd = -1;
+	Conditions conditions;
+	std::mt19937 rng;
+
+	typedef std::chrono::steady_clock Clock;
+	struct Delayed {
+		Clock::time_point due;
+		uint16_t to_port;
+		std::vector< uint8_t > data;
+	};
+	std::deque< Delayed > delayed; //packets waiting out their simulated latency
+
+	void send_now(uint16_t to_port, void const *data, size_t size);
+
+	//statistics:
+	uint64_t sent = 0, dropped = 0, received = 0;
+};
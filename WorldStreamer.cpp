@@ -0,0 +1,195 @@
+#include "WorldStreamer.hpp"
+
+#include "Level.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//a mod b, for b > 0, always in [0,b):
+static int32_t wrap(int32_t a, int32_t b) {
+	return ((a % b) + b) % b;
+}
+
+//a / b, for b > 0, rounded down:
+static int32_t floor_div(int32_t a, int32_t b) {
+	return (a >= 0 ? a / b : -((-a + b - 1) / b));
+}
+
+WorldStreamer::WorldStreamer(std::string const &filename, uint32_t which) {
+	//map the whole file:
+	#if defined(_WIN32)
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open world '" + filename + "'.");
+	}
+	file_handle = file;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		throw std::runtime_error("Failed to get the size of world '" + filename + "'.");
+	}
+	mapped_size = size_t(size.QuadPart);
+	if (mapped_size > 0) {
+		mapping_handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping_handle) mapped = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+		if (!mapped) {
+			if (mapping_handle) CloseHandle(mapping_handle);
+			CloseHandle(file);
+			throw std::runtime_error("Failed to map world '" + filename + "'.");
+		}
+	}
+	#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to open world '" + filename + "'.");
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		throw std::runtime_error("Failed to get the size of world '" + filename + "'.");
+	}
+	mapped_size = size_t(info.st_size);
+	if (mapped_size > 0) {
+		void *at = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (at == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("Failed to map world '" + filename + "'.");
+		}
+		mapped = at;
+	}
+	close(fd); //(the mapping stays valid without the descriptor)
+	#endif
+
+	//find the level (same layout read_chunk() reads: "lvl0" levels, then "nmt0" nametable):
+	auto fail = [&](std::string const &why) {
+		unmap(); //(the constructor didn't finish, so the destructor won't run)
+		throw std::runtime_error("World '" + filename + "' " + why + ".");
+	};
+	struct ChunkHeader {
+		char magic[4] = {'\0', '\0', '\0', '\0'};
+		uint32_t size = 0;
+	};
+	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+	char const *bytes = reinterpret_cast< char const * >(mapped);
+
+	ChunkHeader levels_header;
+	if (mapped_size < sizeof(ChunkHeader)) fail("is too short to hold levels");
+	std::memcpy(&levels_header, bytes, sizeof(ChunkHeader));
+	if (std::string(levels_header.magic, 4) != "lvl0" || levels_header.size % sizeof(Levels::Level) != 0
+	 || mapped_size - sizeof(ChunkHeader) < levels_header.size) fail("doesn't start with a levels chunk");
+	if (which >= levels_header.size / sizeof(Levels::Level)) fail("has no level " + std::to_string(which));
+	Levels::Level level;
+	std::memcpy(&level, bytes + sizeof(ChunkHeader) + which * sizeof(Levels::Level), sizeof(Levels::Level));
+
+	size_t nametable_at = sizeof(ChunkHeader) + levels_header.size;
+	ChunkHeader nametable_header;
+	if (mapped_size - nametable_at < sizeof(ChunkHeader)) fail("has no nametable chunk");
+	std::memcpy(&nametable_header, bytes + nametable_at, sizeof(ChunkHeader));
+	if (std::string(nametable_header.magic, 4) != "nmt0" || nametable_header.size % 2 != 0
+	 || mapped_size - nametable_at - sizeof(ChunkHeader) < nametable_header.size) fail("has a damaged nametable chunk");
+	if (uint64_t(level.first_entry) + uint64_t(level.width) * level.height > nametable_header.size / 2) {
+		fail("has a level that runs past the end of its nametable");
+	}
+
+	//(chunk sizes are multiples of 12 and 2, so the nametable starts 2-byte aligned in the page-aligned mapping)
+	static_assert(sizeof(Levels::Level) % 2 == 0 && sizeof(ChunkHeader) % 2 == 0, "nametable entries are aligned");
+	entries = reinterpret_cast< uint16_t const * >(bytes + nametable_at + sizeof(ChunkHeader)) + level.first_entry;
+	width = level.width;
+	height = level.height;
+}
+
+WorldStreamer::~WorldStreamer() {
+	unmap();
+}
+
+void WorldStreamer::unmap() {
+	#if defined(_WIN32)
+	if (mapped) UnmapViewOfFile(mapped);
+	if (mapping_handle) CloseHandle(mapping_handle);
+	if (file_handle) CloseHandle(file_handle);
+	mapping_handle = file_handle = nullptr;
+	#else
+	if (mapped) munmap(mapped, mapped_size);
+	#endif
+	mapped = nullptr;
+	entries = nullptr;
+}
+
+glm::ivec2 WorldStreamer::window_for(glm::ivec2 const &background_position) const {
+	//the screen shows background pixel (screen pixel - background_position), so its lower left is world pixel -background_position:
+	glm::ivec2 camera = -background_position;
+	//33 columns and 31 rows of tiles are (at least partly) on screen; center them in the 64x60 window:
+	constexpr int32_t SlackX = (int32_t(PPU466::BackgroundWidth) - (int32_t(PPU466::ScreenWidth) / 8 + 1)) / 2;
+	constexpr int32_t SlackY = (int32_t(PPU466::BackgroundHeight) - (int32_t(PPU466::ScreenHeight) / 8 + 1)) / 2;
+	return glm::ivec2(floor_div(camera.x, 8) - SlackX, floor_div(camera.y, 8) - SlackY);
+}
+
+void WorldStreamer::load_columns(int32_t x_begin, int32_t x_end, PPU466 *ppu) const {
+	std::array< uint16_t, PPU466::BackgroundHeight > column;
+	for (int32_t x = x_begin; x < x_end; ++x) {
+		//arrange the column's window rows in the order the background's (wrapped) rows hold them:
+		for (int32_t i = 0; i < int32_t(PPU466::BackgroundHeight); ++i) {
+			int32_t y = window.y + i;
+			column[wrap(y, PPU466::BackgroundHeight)] = entry(x, y);
+		}
+		ppu->set_background_column(wrap(x, PPU466::BackgroundWidth), 0, PPU466::BackgroundHeight, column.data());
+	}
+}
+
+void WorldStreamer::load_rows(int32_t y_begin, int32_t y_end, PPU466 *ppu) const {
+	std::array< uint16_t, PPU466::BackgroundWidth > row;
+	for (int32_t y = y_begin; y < y_end; ++y) {
+		for (int32_t i = 0; i < int32_t(PPU466::BackgroundWidth); ++i) {
+			int32_t x = window.x + i;
+			row[wrap(x, PPU466::BackgroundWidth)] = entry(x, y);
+		}
+		ppu->set_background_rect(0, wrap(y, PPU466::BackgroundHeight), PPU466::BackgroundWidth, 1, row.data());
+	}
+}
+
+void WorldStreamer::update(PPU466 *ppu) {
+	assert(ppu);
+	glm::ivec2 want = window_for(ppu->background_position);
+	stats.updates += 1;
+
+	constexpr int32_t W = PPU466::BackgroundWidth;
+	constexpr int32_t H = PPU466::BackgroundHeight;
+	if (!loaded || std::abs(want.x - window.x) >= W || std::abs(want.y - window.y) >= H) {
+		//nothing worth keeping; load the whole window:
+		window = want;
+		load_columns(window.x, window.x + W, ppu);
+		loaded = true;
+		stats.full_loads += 1;
+		stats.columns += W;
+		return;
+	}
+
+	//slide sideways first, loading the columns that come into the window (over the rows it had):
+	if (want.x != window.x) {
+		int32_t begin = (want.x > window.x ? window.x + W : want.x);
+		int32_t end = (want.x > window.x ? want.x + W : window.x);
+		window.x = want.x;
+		load_columns(begin, end, ppu);
+		stats.columns += uint32_t(end - begin);
+	}
+	//...then up or down, loading the rows that come into the window (over its new columns):
+	if (want.y != window.y) {
+		int32_t begin = (want.y > window.y ? window.y + H : want.y);
+		int32_t end = (want.y > window.y ? want.y + H : window.y);
+		window.y = want.y;
+		load_rows(begin, end, ppu);
+		stats.rows += uint32_t(end - begin);
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+/*
+ * WorldStreamer -- scrolls a level bigger than the 64x60-tile background through it.
+ *
+ * The background wraps around, so it can act as a ring buffer: world tile (x,y) lives in
+ *  background tile (x % 64, y % 60), and as the view moves only the columns and rows that
+ *  come into range need to be written (and uploaded -- see PPU466::set_background_column).
+ * The level's nametable is read straight out of a memory-mapped levels.chunk (see Level.hpp),
+ *  so even a huge world costs nothing to "load" and only the pages that get scrolled past are read.
+ *
+ * Usage: each frame, set ppu.background_position = -camera (the camera being the world pixel at
+ *  the lower left of the screen; don't reduce it modulo 512x480) and call update(&ppu).
+ * The work done is proportional to how far the view moved: one 60-entry column per 8 pixels of
+ *  horizontal scrolling, one 64-entry row per 8 pixels of vertical scrolling.
+ * (scanline_scroll offsets aren't tracked; the window keeps ~15 tiles of slack on each side.)
+ */
+
+#include "PPU466.hpp"
+
+#include <cstdint>
+#include <string>
+
+struct WorldStreamer {
+	//map 'filename' (a levels.chunk written by the asset converter) and stream level 'which' from it:
+	// (throws on error)
+	WorldStreamer(std::string const &filename, uint32_t which);
+	~WorldStreamer();
+	WorldStreamer(WorldStreamer const &) = delete;
+	WorldStreamer &operator=(WorldStreamer const &) = delete;
+
+	//background entry to show past the edges of the level:
+	uint16_t outside = 0;
+
+	//bring the background up to date with ppu->background_position:
+	void update(PPU466 *ppu);
+	//forget what the background holds (e.g., after something else wrote to it), so the next update() loads all of it:
+	void reset() { loaded = false; }
+
+	//level size in tiles:
+	uint32_t width = 0;
+	uint32_t height = 0;
+	//world entry at tile (x,y) ('outside' if that's not in the level):
+	uint16_t entry(int32_t x, int32_t y) const {
+		if (x < 0 || y < 0 || uint32_t(x) >= width || uint32_t(y) >= height) return outside;
+		return entries[size_t(x) * height + uint32_t(y)];
+	}
+
+	struct Stats {
+		uint64_t updates = 0;
+		uint64_t columns = 0; //columns streamed in
+		uint64_t rows = 0; //rows streamed in
+		uint64_t full_loads = 0; //updates that (re)loaded the whole background
+	} stats;
+
+	//----- internals -----
+	//the window of world tiles the background holds: [window, window + (64,60)):
+	glm::ivec2 window = glm::ivec2(0);
+	bool loaded = false;
+	glm::ivec2 window_for(glm::ivec2 const &background_position) const;
+	void load_columns(int32_t x_begin, int32_t x_end, PPU466 *ppu) const; //world columns, over the window's rows
+	void load_rows(int32_t y_begin, int32_t y_end, PPU466 *ppu) const; //world rows, over the window's columns
+
+	uint16_t const *entries = nullptr; //column-major nametable of the level, inside the mapped file
+
+	void unmap();
+	void *mapped = nullptr; //the mapped file
+	size_t mapped_size = 0;
+	#if defined(_WIN32)
+	void *file_handle = nullptr;
+	void *mapping_handle = nullptr;
+	#endif
+};
@@ -8,23 +8,52 @@
 #include <algorithm>
 #include <cassert>
 #include <filesystem>
+#include <unordered_map>
+#include <bitset>
+#include <functional>
+#include <chrono>
+#include <sstream>
+#include <array>
+#include <cstdio>
+#include <cmath>
+#include <limits>
+#include <numeric>
 
 #include <glm/glm.hpp>
 
 #include "PPU466.hpp"
+#include "Metasprite.hpp"
+#include "Level.hpp"
 #include "read_write_chunk.hpp"
 #include "load_save_png.hpp"
+#include "ThreadPool.hpp"
+#include "Checksum.hpp"
 
 namespace fs = std::filesystem;
 
 constexpr char USAGE_PROMPT[] = R"(
 usage:
-  ./asset_pipe_converter <input-tile-dir> <output-chunk-dir> <output-header-dir>
+  ./asset_pipe_converter <input-tile-dir> <output-chunk-dir> <output-header-dir> [<cache-file>] [--levels <input-level-dir>] [--quantize] [--tile-texture]
+
+  <cache-file> remembers the decoded PNGs by content hash between runs,
+  so unchanged PNGs aren't decoded again (default: build_tools_bin/asset_pipe_converter.cache)
+  <input-level-dir> holds *.png level maps, compiled to background nametables (default: none)
+  --quantize reduces tiles with more than 4 colors, and colors that don't fit in 8 palettes,
+  instead of stopping with an error
+  --tile-texture also writes tile_texture.chunk, the tiles already unpacked into the texture the game uploads
+
+  besides the chunks, <output-header-dir> gets assets_res.h (index macros) and assets_embedded.hpp
+  (the tiles and palettes as constexpr tables, and typed handles -- what the game is built with),
+  so resource names have to be C++ identifiers once lowercased
 
 example:
-  ./build_tools_bin/asset_pipe_converter assets/sprites/ dist/assets/ generated/include/
+  ./build_tools_bin/asset_pipe_converter assets/sprites/ dist/assets/ generated/include/ --levels assets/levels/ --tile-texture
 )";
 
+// bump this whenever a change to the converter would change its output for the same input,
+// so that build caches from older converters are ignored:
+constexpr uint32_t CONVERTER_VERSION = 5;
+
 /**
  * AssetConversionException: represents an error during the asset pipeline.
  *
@@ -42,36 +71,147 @@ struct ImgContent {
 	std::vector<glm::u8vec4> data;
 };
 
+struct CachedImage {
+	uint64_t hash = 0; // hash of the PNG file's bytes
+	ImgContent image; // what they decoded to
+};
+// how the cache file stores each entry (names and pixels are in their own chunks):
+struct CacheEntry {
+	uint64_t hash = 0;
+	uint32_t name_begin = 0, name_end = 0; // range of the names chunk
+	uint32_t width = 0, height = 0;
+	uint32_t pixels_begin = 0; // first pixel in the pixels chunk (width * height of them)
+	uint32_t padding = 0;
+};
+static_assert(sizeof(CacheEntry) == 32, "CacheEntry is packed");
+
+// the build cache: ( key: PNG file path, value: decoded image and the hash of the file it came from )
+typedef std::map<std::string, CachedImage> SpriteCache;
+
+/**
+ * load the build cache written by store_sprite_cache(). never throws:
+ * a missing, damaged, or out-of-date (different CONVERTER_VERSION) cache is just empty.
+ */
+SpriteCache load_sprite_cache(const std::string &cache_file);
+/**
+ * write the build cache (only if it changed). throws exception on error
+ */
+void store_sprite_cache(const SpriteCache &cache, const std::string &cache_file);
+
 /**
  * load raw sprite PNG images from disk. throws exception on error
+ * (files are decoded in parallel, but the result doesn't depend on which thread did what)
  *
- * @param tile_dir the directory that contains all the *.png sprites
+ * @param tile_dir the directory that contains all the *.png sprites (or levels)
+ * @param cache the build cache: files whose bytes hash the same as their entry here aren't decoded again
+ * @param used gets entries for the files that were loaded (so it ends up holding exactly the files still in use)
  * @return the dict of ( key: resource name, value: PNG content )
  * @throw exception if a failure happens
  */
-std::map<std::string, ImgContent> load_raw_sprite_images(const std::string &tile_dir);
+std::map<std::string, ImgContent> load_raw_sprite_images(const std::string &tile_dir, const SpriteCache &cache, SpriteCache *used);
 
+// where a resource ended up: resources with the same pixels (up to mirroring) share a tile,
+// and 'flip' (PPU466::FlipX / FlipY bits) says how to show the shared tile to get this resource back
+struct SpriteRef {
+	int tile_index = -1;
+	int palette_index = -1;
+	uint8_t flip = 0;
+};
+// where a multi-tile resource ended up: its frames are metasprites first, first + 1, ..., first + frames - 1
+struct MetaspriteRef {
+	uint32_t first = 0;
+	uint32_t frames = 0;
+};
+// where a level ended up: its nametable is entries first_entry .. first_entry + width * height - 1
+struct LevelRef {
+	uint32_t index = 0;
+	uint32_t width = 0, height = 0; // in tiles
+};
 struct ProcessedSprites {
 	std::vector<PPU466::Tile> tiles;
 	std::vector<PPU466::Palette> palettes;
-	// mapping: ( key: resource name, value: (tile_index, palette_index))
-	std::map<std::string, std::pair<int, int>> mapping;
+	// mapping: ( key: resource name, value: (tile_index, palette_index, flip))
+	std::map<std::string, SpriteRef> mapping;
+	// metasprites (see Metasprite.hpp), and which of them each multi-tile resource is:
+	std::vector<Metasprites::Part> parts;
+	std::vector<Metasprites::Metasprite> metasprites;
+	std::map<std::string, MetaspriteRef> metasprite_mapping;
+	// levels (see Level.hpp): background entries of every level, column by column, and where each level starts:
+	std::vector<Levels::Level> levels;
+	std::vector<uint16_t> nametable;
+	std::map<std::string, LevelRef> level_mapping;
 };
 /**
  * read raw sprite images and attempt to convert to ProcessedSprites, which contains
- * PPU466-targeted tiles, palettes.
+ * PPU466-targeted tiles, palettes, and metasprites.
+ *
+ * 8x8 images are one-tile resources. Bigger images (any multiple of 8 in each direction) are sliced into
+ * 8x8 cells and become metasprites; an image named like 'walk@16x16' is a sheet of 16x16 frames, one
+ * metasprite per frame, in reading order. Every cell goes through the same palette packing and tile sharing,
+ * and blank cells are left out.
+ *
+ * Levels (also any multiple of 8 in each direction) are sliced the same way, blank cells included, and become
+ * nametables of PPU466::background entries, stored column by column so a scrolling map can be read one column at a time.
  *
  * @param raw_images the raw sprite images, returned by load_raw_sprite_images()
+ * @param raw_levels the raw level images, also returned by load_raw_sprite_images()
+ * @param quantize if true, instead of failing when a tile has more than 4 colors or the colors don't fit in
+ *   8 palettes, reduce them: each tile to 4 colors (quantize_cell()), all of them to 32 colors (cluster_colors()) if there
+ *   are more, then merge the closest colors overall until they fit
  * @return a ProcessedSprites struct that represents the tiles palettes and mapping
  * @throw exception if a failure happens, e.g. when too many colors are used.
  */
-ProcessedSprites process_sprite_images(const std::map<std::string, ImgContent> &raw_images);
+ProcessedSprites process_sprite_images(const std::map<std::string, ImgContent> &raw_images, const std::map<std::string, ImgContent> &raw_levels, bool quantize);
+
+/**
+ * palette packing: find as few palettes as possible (each a set of at most 4 colors)
+ * such that every color set in 'sets' is contained in one of them.
+ * Color sets are bitmasks: bit i set <-> the set has color i.
+ *
+ * Sets contained in other sets are dropped first (they can share their superset's palette);
+ * the rest are packed by an exact branch-and-bound search when there are few of them,
+ * and by a greedy "add the fewest new colors" heuristic otherwise (or if the search runs too long).
+ *
+ * @param sets the color sets used by the sprites (each with at most 4 colors)
+ * @param optimal set to whether the result is known to use the fewest palettes possible
+ * @return the palettes' color sets, in no particular order
+ */
+std::vector<uint32_t> pack_palettes(std::vector<uint32_t> sets, bool *optimal);
+
+/**
+ * convert a color to Oklab (a perceptual color space: distances roughly match how different colors look),
+ * with alpha (0-1) as the fourth component.
+ */
+glm::vec4 to_oklab(glm::u8vec4 color);
+/**
+ * weighted k-means of colors in Oklab (farthest-point start, then up to 16 rounds), in O(colors * k) per round.
+ * Each color becomes the member of its cluster nearest the cluster's center -- so no new colors are invented.
+ *
+ * @param lab color id -> to_oklab() of that color
+ * @param ids the (distinct, opaque) colors to cluster
+ * @param weights how much each of 'ids' counts (e.g., how many pixels have it)
+ * @return for each of 'ids', the color id it becomes (itself, if there are at most k colors)
+ */
+std::vector<uint32_t> cluster_colors(const std::vector<glm::vec4> &lab, const std::vector<uint32_t> &ids, const std::vector<float> &weights, uint32_t k);
+/**
+ * reduce an 8x8 tile to at most 'max_colors' different colors with cluster_colors() (weighted by how many
+ * pixels have each color), so tiles keep sharing colors with each other.
+ * Fully transparent pixels are left alone (and count as one of the colors).
+ *
+ * @param lab color id -> to_oklab() of that color
+ * @param pixels the tile's color ids; changed in place
+ */
+void quantize_cell(const std::vector<glm::vec4> &lab, std::array<uint32_t, 8 * 8> *pixels, uint32_t max_colors);
 
 /**
- * Give the processed sprites, save it to disk. It includes:
+ * Give the processed sprites, save it to disk (files whose contents wouldn't change are left alone). It includes:
  *   $output_chunk_dir/tiles.chunk,
  *   $output_chunk_dir/palettes.chunk,
+ *   $output_chunk_dir/metasprites.chunk,
+ *   $output_chunk_dir/levels.chunk,
+ *   $output_chunk_dir/tile_texture.chunk (only if 'tile_texture' is set),
  *   $output_header_dir/assets_res.h,
+ *   $output_header_dir/assets_embedded.hpp,
  *
  * @param sprites the processed sprites, from process_sprite_images() function
  * @param output_chunk_dir the destination for .chunk files,
@@ -80,26 +220,62 @@ ProcessedSprites process_sprite_images(const std::map<std::string, ImgContent> &
  * @param output_header_dir the destnation for generated c++ header files
  *   Should be either relative to current working directory, or an absolute path.
  *   Will be created automatically if it doesn't exist.
+ * @param tile_texture also write the tile table already unpacked into the 128x128 texture PPU466::draw() uploads
+ *   (with the 256-tile table it was made from, so the game can tell whether it still matches), see PPU466::register_tile_texture()
  * @throw exception if any errors happened.
  */
 
 void store_sprite_resources(
 	const ProcessedSprites &sprites,
 	const std::string &output_chunk_dir,
-	const std::string &output_header_dir);
+	const std::string &output_header_dir,
+	bool tile_texture);
 void store_sprite_header_file(const ProcessedSprites &sprites, const std::string &output_header_dir);
-void store_sprite_chunk_file(const ProcessedSprites &sprites, const std::string &output_chunk_dir);
+/**
+ * write the tiles and palettes themselves as constexpr tables in a header (so they are compiled into the game,
+ * with no files to read at startup), along with a constexpr handle for each resource, typed by what the
+ * resource is (see the assets::Sprite, assets::Metasprite, and assets::Level structs it declares).
+ * Resource names must then be usable as C++ identifiers (once lowercased). throws exception on error
+ */
+void store_embedded_header_file(const ProcessedSprites &sprites, const std::string &output_header_dir);
+void store_sprite_chunk_file(const ProcessedSprites &sprites, const std::string &output_chunk_dir, bool tile_texture);
+
+/**
+ * write 'bytes' to 'path' unless the file already holds exactly those bytes
+ * (so a no-op build doesn't touch timestamps and cause recompiles). throws exception on error
+ */
+void write_if_changed(const std::string &path, const std::string &bytes);
 
 int main(int argc, char *argv[]) {
-	if (argc != 4) {
+	std::vector<std::string> args;
+	std::string level_dir;
+	bool quantize = false;
+	bool tile_texture = false;
+	for (int i = 1; i < argc; ++i) {
+		if (std::string(argv[i]) == "--quantize") {
+			quantize = true;
+		} else if (std::string(argv[i]) == "--tile-texture") {
+			tile_texture = true;
+		} else if (std::string(argv[i]) == "--levels" && i + 1 < argc) {
+			level_dir = argv[++i];
+		} else {
+			args.emplace_back(argv[i]);
+		}
+	}
+	if (args.size() != 3 && args.size() != 4) {
 		std::cout << USAGE_PROMPT << std::endl;
 		return 1;
 	}
-	// TODO: implement me
+	const std::string cache_file = (args.size() == 4 ? args[3] : "build_tools_bin/asset_pipe_converter.cache");
 	try {
-		std::map<std::string, ImgContent> raw_images = load_raw_sprite_images(argv[1]);
-		ProcessedSprites processed_sprites = process_sprite_images(raw_images);
-		store_sprite_resources(processed_sprites, argv[2], argv[3]);
+		SpriteCache cache = load_sprite_cache(cache_file);
+		SpriteCache used; // (the next build's cache: just the files this one read)
+		std::map<std::string, ImgContent> raw_images = load_raw_sprite_images(args[0], cache, &used);
+		std::map<std::string, ImgContent> raw_levels;
+		if (!level_dir.empty()) raw_levels = load_raw_sprite_images(level_dir, cache, &used);
+		ProcessedSprites processed_sprites = process_sprite_images(raw_images, raw_levels, quantize);
+		store_sprite_resources(processed_sprites, args[1], args[2], tile_texture);
+		store_sprite_cache(used, cache_file);
 		return 0;
 	} catch (const std::exception &e) {
 		std::cerr << e.what() << std::endl;
@@ -108,18 +284,161 @@ int main(int argc, char *argv[]) {
 	return 1;
 }
 
-std::map<std::string, ImgContent> load_raw_sprite_images(const std::string &tile_dir) {
-	std::map<std::string, ImgContent> mapping;
+SpriteCache load_sprite_cache(const std::string &cache_file) {
+	std::ifstream from(cache_file, std::ios::binary);
+	if (!from) return SpriteCache();
+	try {
+		std::vector<uint32_t> version;
+		read_chunk(from, "acv0", &version);
+		if (version.size() != 1 || version[0] != CONVERTER_VERSION) {
+			std::cout << "ignoring build cache from a different converter version" << std::endl;
+			return SpriteCache();
+		}
+		std::vector<char> names;
+		std::vector<CacheEntry> entries;
+		std::vector<glm::u8vec4> pixels;
+		read_chunk(from, "acn0", &names);
+		read_chunk(from, "ace0", &entries);
+		read_chunk(from, "acp0", &pixels);
+
+		SpriteCache cache;
+		for (const CacheEntry &entry : entries) {
+			if (entry.name_begin > entry.name_end || entry.name_end > names.size()
+			 || uint64_t(entry.width) * entry.height > pixels.size() - std::min<size_t>(entry.pixels_begin, pixels.size())) {
+				throw std::runtime_error("entry out of range");
+			}
+			CachedImage &cached = cache[std::string(names.begin() + entry.name_begin, names.begin() + entry.name_end)];
+			cached.hash = entry.hash;
+			cached.image.size = glm::uvec2(entry.width, entry.height);
+			cached.image.data.assign(pixels.begin() + entry.pixels_begin, pixels.begin() + entry.pixels_begin + entry.width * entry.height);
+		}
+		return cache;
+	} catch (const std::exception &e) {
+		std::cout << "ignoring damaged build cache '" << cache_file << "' (" << e.what() << ")" << std::endl;
+		return SpriteCache();
+	}
+}
+
+void store_sprite_cache(const SpriteCache &cache, const std::string &cache_file) {
+	std::vector<uint32_t> version{CONVERTER_VERSION};
+	std::vector<char> names;
+	std::vector<CacheEntry> entries;
+	std::vector<glm::u8vec4> pixels;
+	for (const auto &[name, cached] : cache) {
+		CacheEntry entry;
+		entry.hash = cached.hash;
+		entry.name_begin = uint32_t(names.size());
+		names.insert(names.end(), name.begin(), name.end());
+		entry.name_end = uint32_t(names.size());
+		entry.width = cached.image.size.x;
+		entry.height = cached.image.size.y;
+		entry.pixels_begin = uint32_t(pixels.size());
+		pixels.insert(pixels.end(), cached.image.data.begin(), cached.image.data.end());
+		entries.push_back(entry);
+	}
+
+	std::ostringstream bytes;
+	write_chunk("acv0", version, &bytes);
+	write_chunk("acn0", names, &bytes);
+	write_chunk("ace0", entries, &bytes);
+	write_chunk("acp0", pixels, &bytes);
+	if (fs::path(cache_file).has_parent_path()) fs::create_directories(fs::path(cache_file).parent_path());
+	write_if_changed(cache_file, bytes.str());
+}
+
+void write_if_changed(const std::string &path, const std::string &bytes) {
+	{ // compare with what's there now:
+		std::ifstream from(path, std::ios::binary);
+		if (from) {
+			std::string existing((std::istreambuf_iterator<char>(from)), std::istreambuf_iterator<char>());
+			if (existing == bytes) {
+				std::cout << "unchanged: " << path << std::endl;
+				return;
+			}
+		}
+	}
+	std::ofstream to(path, std::ios::binary);
+	if (!to) {
+		throw AssetConversionException("Error opening " + path);
+	}
+	to.write(bytes.data(), bytes.size());
+	if (to.fail()) {
+		throw AssetConversionException("Error writing to " + path);
+	}
+	std::cout << "wrote: " << path << std::endl;
+}
+
+std::map<std::string, ImgContent> load_raw_sprite_images(const std::string &tile_dir, const SpriteCache &cache, SpriteCache *used) {
+	assert(used);
+	// list the files first, in name order, so everything after this is deterministic:
+	std::vector<std::pair<std::string, fs::path>> files;
 	for (const auto& entry : fs::directory_iterator(tile_dir)){
 		const auto filename_str = entry.path().filename().string();
 		std::string extension = filename_str.substr(filename_str.find('.')+1);
 		if (extension == "png"){
-			ImgContent img;
-			load_png(entry.path(), &img.size, &img.data, LowerLeftOrigin);
 			std::string name = filename_str.substr(0, filename_str.find('.'));
-			mapping[name] = img;
+			files.emplace_back(name, entry.path());
 		}
 	}
+	std::sort(files.begin(), files.end());
+
+	// hash and (if the cache doesn't have it) decode on a thread pool: each file writes only its own slot of
+	// 'images' / 'hashes' / 'errors', and each worker reads and decodes into its own scratch buffers
+	// (so their capacity is reused from file to file); 'cache' is only read here:
+	auto before = std::chrono::high_resolution_clock::now();
+	std::vector<ImgContent> images(files.size());
+	std::vector<uint64_t> hashes(files.size());
+	std::vector<std::string> errors(files.size());
+	std::vector<char> decoded(files.size(), 0);
+	ThreadPool pool;
+	struct Scratch {
+		std::string bytes;
+		std::vector<glm::u8vec4> data;
+	};
+	std::vector<Scratch> scratch(pool.size());
+	for (size_t i = 0; i < files.size(); ++i) {
+		pool.run([&, i](uint32_t worker) {
+			try {
+				Scratch &buffers = scratch[worker];
+				{ // hash the file's bytes:
+					std::ifstream from(files[i].second, std::ios::binary);
+					if (!from) throw std::runtime_error("Failed to open PNG image file '" + files[i].second.string() + "'.");
+					buffers.bytes.assign(std::istreambuf_iterator<char>(from), std::istreambuf_iterator<char>());
+					hashes[i] = Checksum::of(buffers.bytes.data(), buffers.bytes.size());
+				}
+				auto cached = cache.find(files[i].second.generic_string());
+				if (cached != cache.end() && cached->second.hash == hashes[i]) {
+					images[i] = cached->second.image;
+					return;
+				}
+				// (decoded from the same bytes that were hashed, so a file changing under us can't pair a stale hash with new pixels)
+				load_png(files[i].second.string(), buffers.bytes, &images[i].size, &buffers.data, LowerLeftOrigin);
+				images[i].data.assign(buffers.data.begin(), buffers.data.end());
+				decoded[i] = 1;
+			} catch (const std::exception &e) {
+				errors[i] = e.what(); // (exceptions can't leave a pool task; reported below)
+			}
+		});
+	}
+	pool.wait();
+	auto after = std::chrono::high_resolution_clock::now();
+
+	// report the first failure in name order, so the same broken directory always gives the same error:
+	for (const auto &error : errors) {
+		if (!error.empty()) throw AssetConversionException(error);
+	}
+
+	std::map<std::string, ImgContent> mapping;
+	size_t decoded_count = 0;
+	for (size_t i = 0; i < files.size(); ++i) {
+		CachedImage &cached = (*used)[files[i].second.generic_string()];
+		cached.hash = hashes[i];
+		cached.image = images[i];
+		mapping[files[i].first] = std::move(images[i]);
+		decoded_count += decoded[i];
+	}
+	std::cout << "decoded " << decoded_count << " of " << files.size() << " images (" << (files.size() - decoded_count) << " were in the build cache) on "
+	          << pool.size() << " threads in " << std::chrono::duration<double, std::milli>(after - before).count() << "ms" << std::endl;
 	std::cout<<"loading sprite images of: ";
 	for (auto const& [key, val] : mapping){
 		std::cout << key << " ";
@@ -128,135 +447,819 @@ std::map<std::string, ImgContent> load_raw_sprite_images(const std::string &tile
 	return mapping;
 }
 
-ProcessedSprites process_sprite_images(const std::map<std::string, ImgContent> &raw_images) {
+// canonical color order: First order by alpha in ascending order,
+// on tie, order by red in ascending order, then by green, then by blue
+static bool color_less(const glm::u8vec4 &a, const glm::u8vec4 &b) {
+	if (a[3] != b[3]) {
+		return a[3] < b[3];
+	} else if (a[0] != b[0]) {
+		return a[0] < b[0];
+	} else if (a[1] != b[1]) {
+		return a[1] < b[1];
+	} else {
+		return a[2] < b[2];
+	}
+}
+
+static uint32_t color_count(uint32_t set) {
+	return uint32_t(std::bitset<32>(set).count());
+}
+
+std::vector<uint32_t> pack_palettes(std::vector<uint32_t> sets, bool *optimal) {
+	assert(optimal);
+
+	// keep only the maximal sets, biggest first (ties in numeric order, to stay deterministic):
+	std::sort(sets.begin(), sets.end(), [](uint32_t a, uint32_t b) {
+		if (color_count(a) != color_count(b)) return color_count(a) > color_count(b);
+		return a < b;
+	});
+	sets.erase(std::unique(sets.begin(), sets.end()), sets.end());
+	std::vector<uint32_t> maximal;
+	for (uint32_t set : sets) {
+		bool contained = false;
+		for (uint32_t bigger : maximal) {
+			if ((set & ~bigger) == 0) contained = true;
+		}
+		if (!contained) maximal.push_back(set);
+	}
+
+	// greedy: put each set where it adds the fewest new colors:
+	std::vector<uint32_t> best;
+	for (uint32_t set : maximal) {
+		int32_t best_bin = -1;
+		uint32_t best_added = 5;
+		for (uint32_t b = 0; b < best.size(); ++b) {
+			uint32_t merged = color_count(best[b] | set);
+			if (merged > 4) continue;
+			uint32_t added = merged - color_count(best[b]);
+			if (added < best_added) {
+				best_added = added;
+				best_bin = int32_t(b);
+			}
+		}
+		if (best_bin == -1) {
+			best.push_back(set);
+		} else {
+			best[best_bin] |= set;
+		}
+	}
+
+	// no packing can beat (all colors) / 4 palettes:
+	uint32_t all = 0;
+	for (uint32_t set : maximal) all |= set;
+	const size_t lower_bound = std::max<size_t>(1, (color_count(all) + 3) / 4);
+	*optimal = (best.size() <= lower_bound);
+
+	// exact search (each set into each palette it fits in, or a new one) if there's room to improve:
+	constexpr size_t EXACT_LIMIT = 24; // sets
+	constexpr uint64_t STEP_LIMIT = 4000000; // search steps before settling for the best so far
+	if (!*optimal && maximal.size() <= EXACT_LIMIT) {
+		std::vector<uint32_t> bins;
+		uint64_t steps = 0;
+		std::function<void(size_t)> search = [&](size_t i) {
+			if (steps++ > STEP_LIMIT || best.size() <= lower_bound) return;
+			if (bins.size() >= best.size()) return;
+			if (i == maximal.size()) {
+				best = bins;
+				return;
+			}
+			for (size_t b = 0; b < bins.size(); ++b) { // (by index: the recursion pushes to 'bins')
+				if (color_count(bins[b] | maximal[i]) > 4) continue;
+				uint32_t old = bins[b];
+				bins[b] |= maximal[i];
+				search(i + 1);
+				bins[b] = old;
+			}
+			bins.push_back(maximal[i]);
+			search(i + 1);
+			bins.pop_back();
+		};
+		search(0);
+		*optimal = (steps <= STEP_LIMIT || best.size() <= lower_bound);
+	}
+	return best;
+}
+
+glm::vec4 to_oklab(glm::u8vec4 color) {
+	// (from https://bottosson.github.io/posts/oklab/ )
+	auto linear = [](uint8_t v) {
+		const float f = v / 255.0f;
+		return (f <= 0.04045f ? f / 12.92f : std::pow((f + 0.055f) / 1.055f, 2.4f));
+	};
+	const float r = linear(color.r), g = linear(color.g), b = linear(color.b);
+	const float l = std::cbrt(0.4122214708f * r + 0.5363325363f * g + 0.0514459929f * b);
+	const float m = std::cbrt(0.2119034982f * r + 0.6806995451f * g + 0.1073969566f * b);
+	const float s = std::cbrt(0.0883024619f * r + 0.2817188376f * g + 0.6299787005f * b);
+	return glm::vec4(
+		0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s,
+		1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s,
+		0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s,
+		color.a / 255.0f);
+}
+
+void quantize_cell(const std::vector<glm::vec4> &lab, std::array<uint32_t, 8 * 8> *pixels_, uint32_t max_colors) {
+	assert(pixels_);
+	std::array<uint32_t, 8 * 8> &pixels = *pixels_;
+
+	// the opaque colors, and how many pixels have each:
+	std::array<uint32_t, 8 * 8> sorted = pixels;
+	std::sort(sorted.begin(), sorted.end());
+	std::vector<uint32_t> ids;
+	std::vector<float> weights;
+	bool transparent = false;
+	for (uint32_t i = 0; i < sorted.size(); ++i) {
+		if (lab[sorted[i]].w == 0.0f) {
+			transparent = true;
+		} else if (!ids.empty() && ids.back() == sorted[i]) {
+			weights.back() += 1.0f;
+		} else {
+			ids.push_back(sorted[i]);
+			weights.push_back(1.0f);
+		}
+	}
+	const uint32_t k = max_colors - (transparent ? 1 : 0);
+	assert(k > 0);
+	if (ids.size() <= k) return;
+
+	const std::vector<uint32_t> into = cluster_colors(lab, ids, weights, k);
+	for (auto &id : pixels) {
+		if (lab[id].w == 0.0f) continue;
+		const uint32_t i = uint32_t(std::distance(ids.begin(), std::lower_bound(ids.begin(), ids.end(), id)));
+		id = into[i];
+	}
+}
+
+std::vector<uint32_t> cluster_colors(const std::vector<glm::vec4> &lab, const std::vector<uint32_t> &ids, const std::vector<float> &weights, uint32_t k) {
+	assert(ids.size() == weights.size() && k > 0);
+	if (ids.size() <= k) return ids;
+
+	auto distance2 = [](const glm::vec4 &a, const glm::vec4 &b) { return glm::dot(a - b, a - b); };
+
+	// start from the most common color, then keep adding the color farthest (by weight * distance^2) from the centers so far:
+	// ('nearest' keeps each color's distance^2 to the closest center so far, so each new center costs one pass)
+	std::vector<glm::vec4> centers;
+	centers.push_back(lab[ids[std::distance(weights.begin(), std::max_element(weights.begin(), weights.end()))]]);
+	std::vector<float> nearest(ids.size(), std::numeric_limits<float>::infinity());
+	while (centers.size() < k) {
+		uint32_t farthest = 0;
+		float farthest_score = -1.0f;
+		for (uint32_t i = 0; i < ids.size(); ++i) {
+			nearest[i] = std::min(nearest[i], distance2(lab[ids[i]], centers.back()));
+			if (weights[i] * nearest[i] > farthest_score) {
+				farthest_score = weights[i] * nearest[i];
+				farthest = i;
+			}
+		}
+		centers.push_back(lab[ids[farthest]]);
+	}
+
+	// k-means:
+	std::vector<uint32_t> cluster(ids.size(), 0);
+	for (uint32_t iteration = 0; iteration < 16; ++iteration) {
+		bool changed = false;
+		for (uint32_t i = 0; i < ids.size(); ++i) {
+			uint32_t best = 0;
+			float best_distance2 = distance2(lab[ids[i]], centers[0]);
+			for (uint32_t c = 1; c < k; ++c) {
+				const float d2 = distance2(lab[ids[i]], centers[c]);
+				if (d2 < best_distance2) {
+					best = c;
+					best_distance2 = d2;
+				}
+			}
+			if (best != cluster[i]) changed = true;
+			cluster[i] = best;
+		}
+		if (!changed && iteration > 0) break;
+		std::vector<glm::vec4> sums(k, glm::vec4(0.0f));
+		std::vector<float> totals(k, 0.0f);
+		for (uint32_t i = 0; i < ids.size(); ++i) {
+			sums[cluster[i]] += weights[i] * lab[ids[i]];
+			totals[cluster[i]] += weights[i];
+		}
+		for (uint32_t c = 0; c < k; ++c) {
+			if (totals[c] > 0.0f) centers[c] = sums[c] / totals[c];
+		}
+	}
+
+	// each cluster becomes its member nearest the center:
+	std::vector<uint32_t> representative(k, -1U);
+	for (uint32_t i = 0; i < ids.size(); ++i) {
+		uint32_t &r = representative[cluster[i]];
+		if (r == -1U || distance2(lab[ids[i]], centers[cluster[i]]) < distance2(lab[ids[r]], centers[cluster[i]])) r = i;
+	}
+	std::vector<uint32_t> into(ids.size());
+	for (uint32_t i = 0; i < ids.size(); ++i) {
+		into[i] = ids[representative[cluster[i]]];
+	}
+	return into;
+}
+
+ProcessedSprites process_sprite_images(const std::map<std::string, ImgContent> &raw_images, const std::map<std::string, ImgContent> &raw_levels, bool quantize) {
 	std::vector<PPU466::Tile> tiles;
 	std::vector<PPU466::Palette> palettes;
-	std::map<std::string, std::pair<int,int>> mapping;
-	for (const auto &img_iterator : raw_images) {
-		const std::string &name = img_iterator.first;
-		const ImgContent &img = img_iterator.second;
-		int tile_index = -1;
-		int palette_index = -1;
-		if (img.size[0] != 8 || img.size[1] != 8) {
+	std::map<std::string, SpriteRef> mapping;
+	std::vector<Metasprites::Part> parts;
+	std::vector<Metasprites::Metasprite> metasprites;
+	std::map<std::string, MetaspriteRef> metasprite_mapping;
+	std::vector<Levels::Level> levels;
+	std::vector<uint16_t> nametable;
+	std::map<std::string, LevelRef> level_mapping;
+
+	// first pass: slice every image into 8x8 cells, which become tiles.
+	// (fully transparent pixels all look the same, so they are all made (0,0,0,0) -- this keeps
+	//  transparency at palette index 0, where PPU466::Tile::opacity_mask() expects it)
+	auto canonical = [](glm::u8vec4 pix) {
+		return (pix.a == 0 ? glm::u8vec4(0, 0, 0, 0) : pix);
+	};
+	// every different color seen gets an id (in order of first appearance); pixels are stored as ids from here on,
+	// and looking one up is a hash, so big sheets don't cost a search of the colors so far per pixel:
+	std::vector<glm::u8vec4> color_table; // id -> color
+	std::unordered_map<uint32_t, uint32_t> color_ids; // packed RGBA -> id
+	std::vector<uint32_t> seen_in; // id -> stamp of the last cell listing that had it (lists a cell's colors without searching)
+	uint32_t listings = 0;
+	auto color_id = [&](glm::u8vec4 pix) {
+		const uint32_t packed = uint32_t(pix.r) | uint32_t(pix.g) << 8 | uint32_t(pix.b) << 16 | uint32_t(pix.a) << 24;
+		auto inserted = color_ids.emplace(packed, uint32_t(color_table.size()));
+		if (inserted.second) {
+			color_table.push_back(pix);
+			seen_in.push_back(-1U);
+		}
+		return inserted.first->second;
+	};
+	struct Cell {
+		std::string label; // for messages: the resource name, plus the frame and offset for metasprite parts
+		std::array<uint32_t, 8 * 8> pixels; // color ids
+		std::vector<uint32_t> colors; // the different color ids in 'pixels', in order of appearance
+		uint32_t part = -1U; // index in 'parts', or -1U for a one-tile resource (which goes in 'mapping')
+		uint32_t entry = -1U; // index in 'nametable', for a level cell
+	};
+	std::vector<Cell> cells;
+	auto list_colors = [&](Cell &cell) {
+		const uint32_t stamp = listings++;
+		cell.colors.clear();
+		for (uint32_t id : cell.pixels) {
+			if (seen_in[id] != stamp) {
+				seen_in[id] = stamp;
+				cell.colors.push_back(id);
+			}
+		}
+	};
+	auto slice = [&](const ImgContent &img, uint32_t x0, uint32_t y0) {
+		Cell cell;
+		for (uint32_t row = 0; row < 8; ++row) {
+			for (uint32_t col = 0; col < 8; ++col) {
+				cell.pixels[row * 8 + col] = color_id(canonical(img.data[(y0 + row) * img.size.x + (x0 + col)]));
+			}
+		}
+		list_colors(cell);
+		return cell;
+	};
+	auto check_name = [&](const std::string &resource, const std::string &file) {
+		if (mapping.count(resource) || metasprite_mapping.count(resource)) {
+			throw AssetConversionException("Two sprite files give the resource name '" + resource + "' (the second is '" + file + ".png').");
+		}
+	};
+	for (const auto &[name, img] : raw_images) {
+		// a sheet of frames is named like 'walk@16x16'; anything else is a single frame the size of the image:
+		std::string resource = name;
+		glm::uvec2 frame_size = img.size;
+		const auto at = name.find('@');
+		if (at != std::string::npos) {
+			resource = name.substr(0, at);
+			unsigned w = 0, h = 0;
+			char end = '\0';
+			if (std::sscanf(name.c_str() + at + 1, "%ux%u%c", &w, &h, &end) != 2) {
+				throw AssetConversionException("Sprite sheet name '" + name + "' should end in '@<width>x<height>' (the frame size).");
+			}
+			frame_size = glm::uvec2(w, h);
+		}
+		if (frame_size.x == 0 || frame_size.y == 0 || frame_size.x % 8 != 0 || frame_size.y % 8 != 0
+		 || img.size.x % frame_size.x != 0 || img.size.y % frame_size.y != 0) {
 			throw AssetConversionException(
-				std::string("Invalid PNG asset size for ") + name + ". Should be 8x8, but actually"
-					+ std::to_string(img.size[0]) + "x" + std::to_string(img.size[1]));
-		}
-		std::vector<glm::u8vec4> colors;
-		// first pass: what's the colors in this img
-		for (const auto &pix : img.data) {
-			auto it = std::find(colors.begin(), colors.end(), pix);
-			if (it != colors.end()) {
-				// no action required
-			} else {
-				colors.push_back(pix);
-				if (colors.size() > 4) {
-					std::string errmsg = std::string("Too many colors used in asset ") + name + ".";
-					throw AssetConversionException(errmsg);
+				std::string("Invalid PNG asset size for ") + name + ": " + std::to_string(img.size[0]) + "x" + std::to_string(img.size[1])
+					+ " should be a whole number of " + std::to_string(frame_size.x) + "x" + std::to_string(frame_size.y)
+					+ " frames, each a whole number of 8x8 tiles");
+		}
+		if (frame_size.x > 256 || frame_size.y > 256) {
+			throw AssetConversionException("Frames of " + name + " are " + std::to_string(frame_size.x) + "x" + std::to_string(frame_size.y)
+				+ ", bigger than the 256x256 a metasprite can be.");
+		}
+		check_name(resource, name);
+
+		// plain 8x8 sprites stay one-tile resources:
+		if (at == std::string::npos && img.size == glm::uvec2(8, 8)) {
+			Cell cell = slice(img, 0, 0);
+			cell.label = resource;
+			cells.emplace_back(std::move(cell));
+			mapping[resource] = SpriteRef{};
+			continue;
+		}
+
+		// anything bigger becomes one metasprite per frame, frames in reading order (top-left first):
+		// (images are stored lower-left origin, so the top row of frames is the last one in memory)
+		const glm::uvec2 frames = img.size / frame_size;
+		metasprite_mapping[resource] = MetaspriteRef{uint32_t(metasprites.size()), frames.x * frames.y};
+		for (uint32_t fy = 0; fy < frames.y; ++fy) {
+			for (uint32_t fx = 0; fx < frames.x; ++fx) {
+				const glm::uvec2 origin(fx * frame_size.x, (frames.y - 1 - fy) * frame_size.y);
+				Metasprites::Metasprite metasprite;
+				metasprite.first_part = uint16_t(parts.size());
+				metasprite.width = uint16_t(frame_size.x);
+				metasprite.height = uint16_t(frame_size.y);
+				for (uint32_t y = 0; y < frame_size.y; y += 8) {
+					for (uint32_t x = 0; x < frame_size.x; x += 8) {
+						Cell cell = slice(img, origin.x + x, origin.y + y);
+						if (cell.colors.size() == 1 && color_table[cell.colors[0]].a == 0) continue; // (blank: no part needed)
+						cell.label = resource + " frame " + std::to_string(fy * frames.x + fx) + " at (" + std::to_string(x) + "," + std::to_string(y) + ")";
+						cell.part = parts.size();
+						Metasprites::Part part;
+						part.x = uint8_t(x);
+						part.y = uint8_t(y);
+						parts.push_back(part);
+						cells.emplace_back(std::move(cell));
+						metasprite.part_count += 1;
+					}
+				}
+				if (parts.size() > 0xffff) {
+					throw AssetConversionException("Too many metasprite parts: exceeds 65535");
+				}
+				metasprites.push_back(metasprite);
+			}
+		}
+	}
+
+	// levels are sliced the same way, blank cells and all; each cell becomes one background entry:
+	for (const auto &[name, img] : raw_levels) {
+		if (img.size.x == 0 || img.size.y == 0 || img.size.x % 8 != 0 || img.size.y % 8 != 0) {
+			throw AssetConversionException(
+				std::string("Invalid PNG level size for ") + name + ": " + std::to_string(img.size[0]) + "x" + std::to_string(img.size[1])
+					+ " should be a whole number of 8x8 tiles");
+		}
+		Levels::Level level;
+		level.width = img.size.x / 8;
+		level.height = img.size.y / 8;
+		level.first_entry = uint32_t(nametable.size());
+		level_mapping[name] = LevelRef{uint32_t(levels.size()), level.width, level.height};
+		levels.push_back(level);
+		nametable.resize(nametable.size() + size_t(level.width) * level.height);
+		// column by column (bottom to top within a column), so each column is contiguous:
+		for (uint32_t x = 0; x < level.width; ++x) {
+			for (uint32_t y = 0; y < level.height; ++y) {
+				Cell cell = slice(img, x * 8, y * 8);
+				cell.label = "level " + name + " at (" + std::to_string(x) + "," + std::to_string(y) + ")";
+				cell.entry = level.first_entry + x * level.height + y;
+				cells.emplace_back(std::move(cell));
+			}
+		}
+	}
+
+	// number the colors the cells use in canonical order, so a set of color numbers lists its colors in canonical order:
+	std::vector<glm::u8vec4> all_colors; // number -> color
+	std::vector<uint32_t> number; // color id -> number (-1U if no cell uses it)
+	auto number_colors = [&]() {
+		number.assign(color_table.size(), -1U);
+		std::vector<uint32_t> used;
+		for (const auto &cell : cells) {
+			for (uint32_t id : cell.colors) {
+				if (number[id] == -1U) {
+					number[id] = 0;
+					used.push_back(id);
+				}
+			}
+		}
+		std::sort(used.begin(), used.end(), [&](uint32_t a, uint32_t b) { return color_less(color_table[a], color_table[b]); });
+		all_colors.clear();
+		for (uint32_t n = 0; n < used.size(); ++n) {
+			number[used[n]] = n;
+			all_colors.push_back(color_table[used[n]]);
+		}
+	};
+	// (only once there are at most 32 colors:)
+	auto color_set = [&number](const std::vector<uint32_t> &colors) {
+		uint32_t set = 0;
+		for (uint32_t id : colors) {
+			set |= 1u << number[id];
+		}
+		return set;
+	};
+	auto cell_sets = [&]() {
+		std::vector<uint32_t> sets;
+		for (const auto &cell : cells) {
+			sets.push_back(color_set(cell.colors));
+		}
+		return sets;
+	};
+
+	if (quantize) {
+		// cells with more than 4 colors are brought down to 4 (see quantize_cell()):
+		std::vector<glm::vec4> lab(color_table.size());
+		std::transform(color_table.begin(), color_table.end(), lab.begin(), to_oklab);
+		uint32_t quantized = 0;
+		for (auto &cell : cells) {
+			if (cell.colors.size() <= 4) continue;
+			quantize_cell(lab, &cell.pixels, 4);
+			list_colors(cell);
+			quantized += 1;
+		}
+		auto count_pixels = [&]() {
+			std::vector<uint64_t> pixel_count(color_table.size(), 0);
+			for (const auto &cell : cells) {
+				for (uint32_t id : cell.pixels) pixel_count[id] += 1;
+			}
+			return pixel_count;
+		};
+		// ...then, if more than 32 colors are left overall (a big photographic sheet can leave thousands), one
+		// cluster_colors() pass over all of them, weighted by pixel count, brings them down to 32 at once:
+		uint32_t clustered = 0;
+		number_colors();
+		if (all_colors.size() > 8 * 4) {
+			const std::vector<uint64_t> pixel_count = count_pixels();
+			std::vector<uint32_t> opaque;
+			std::vector<float> weights;
+			uint32_t transparent = 0;
+			for (uint32_t id = 0; id < color_table.size(); ++id) {
+				if (!pixel_count[id]) continue;
+				if (color_table[id].a == 0) {
+					transparent += 1;
+				} else {
+					opaque.push_back(id);
+					weights.push_back(float(pixel_count[id]));
+				}
+			}
+			const std::vector<uint32_t> into = cluster_colors(lab, opaque, weights, std::max(1u, 8 * 4 - std::min(transparent, 8u * 4)));
+			std::vector<uint32_t> remap(color_table.size());
+			std::iota(remap.begin(), remap.end(), 0);
+			for (uint32_t i = 0; i < opaque.size(); ++i) {
+				remap[opaque[i]] = into[i];
+			}
+			for (auto &cell : cells) {
+				for (auto &id : cell.pixels) id = remap[id];
+				list_colors(cell);
+			}
+			clustered = uint32_t(all_colors.size());
+			number_colors();
+			clustered -= uint32_t(all_colors.size());
+		}
+		// ...and finally, while the colors don't fit in 8 palettes, the two closest colors are merged everywhere, closeness
+		// being Ward's criterion: distance in Oklab, weighted by how many pixels would change:
+		// (at most 32 colors by now, so this is a few rounds over a few hundred pairs)
+		uint32_t merged = 0;
+		while (true) {
+			number_colors();
+			if (all_colors.size() <= 8 * 4) {
+				bool fit_optimal = false;
+				if (pack_palettes(cell_sets(), &fit_optimal).size() <= 8) break;
+			}
+			const std::vector<uint64_t> pixel_count = count_pixels();
+			std::vector<uint32_t> opaque;
+			for (uint32_t id = 0; id < color_table.size(); ++id) {
+				if (pixel_count[id] && color_table[id].a != 0) opaque.push_back(id);
+			}
+			assert(opaque.size() >= 2 && "(at most 3 opaque colors always fit in one palette)");
+			uint32_t from = -1U, into = -1U;
+			float best = std::numeric_limits<float>::infinity();
+			for (uint32_t i = 0; i < opaque.size(); ++i) {
+				for (uint32_t j = i + 1; j < opaque.size(); ++j) {
+					const glm::vec4 d = lab[opaque[i]] - lab[opaque[j]];
+					const float na = float(pixel_count[opaque[i]]), nb = float(pixel_count[opaque[j]]);
+					const float cost = glm::dot(d, d) * na * nb / (na + nb);
+					if (cost < best) {
+						best = cost;
+						// (the less-used color takes on the more-used one)
+						from = (na < nb ? opaque[i] : opaque[j]);
+						into = (na < nb ? opaque[j] : opaque[i]);
+					}
 				}
 			}
+			for (auto &cell : cells) {
+				if (std::find(cell.colors.begin(), cell.colors.end(), from) == cell.colors.end()) continue;
+				std::replace(cell.pixels.begin(), cell.pixels.end(), from, into);
+				list_colors(cell);
+			}
+			merged += 1;
 		}
-		// sort colors in a canonical order: First order by alpha in ascending order,
-		// on tie, order by red in ascending order, then by green, then by blue
-		std::sort(colors.begin(), colors.end(),
-				  [](const glm::u8vec4 &a, const glm::u8vec4 &b) -> bool {
-					  if (a[3] != b[3]) {
-						  return a[3] < b[3];
-					  } else if (a[0] != b[0]) {
-						  return a[0] < b[0];
-					  } else if (a[1] != b[1]) {
-						  return a[1] < b[1];
-					  } else {
-						  return a[2] < b[2];
-					  }
-				  });
-		assert(colors.size() <= 4);
-		// pad zeroes if colors.size() < 4;
-		colors.resize(4, glm::u8vec4{0, 0, 0, 0});
-		PPU466::Palette p;
-		std::copy(colors.begin(), colors.end(), p.begin());
-		const auto palette_it = std::find(palettes.begin(), palettes.end(), p);
-		for (const auto &c : p) {
-			printf("Colors used in %s: #%02hhx%02hhx%02hhx%02hhx\n", name.c_str(), c.x, c.y, c.z, c.w);
-		}
-		if (palette_it != palettes.end()) {
-			palette_index = std::distance(palettes.begin(), palette_it);
+		std::cout << "quantized " << quantized << " tiles with more than 4 colors, clustered away " << clustered << " colors, and merged "
+		          << merged << " colors to fit in 8 palettes" << std::endl;
+	}
+
+	for (const auto &cell : cells) {
+		if (cell.colors.size() > 4) {
+			std::string errmsg = std::string("Too many colors used in asset ") + cell.label + ". (--quantize reduces it automatically.)";
+			throw AssetConversionException(errmsg);
+		}
+	}
+	number_colors();
+	if (all_colors.size() > 8 * 4) {
+		throw AssetConversionException("Too many palettes: " + std::to_string(all_colors.size())
+			+ " different colors can't fit in 8 palettes of 4");
+	}
+
+	// pack the cells' color sets into as few palettes as possible:
+	std::vector<uint32_t> sets = cell_sets();
+	bool optimal = false;
+	std::vector<uint32_t> packed = pack_palettes(sets, &optimal);
+	std::cout << "packed " << sets.size() << " tiles' colors into " << packed.size() << " palettes ("
+	          << (optimal ? "optimal" : "best found") << ")" << std::endl;
+	if (packed.size() > 8) {
+		throw AssetConversionException("Too many palettes: the sprites' colors need "
+			+ std::to_string(packed.size()) + " palettes of 4, exceeds 8");
+	}
+
+	// tiles stored so far, for spotting repeats:
+	struct TileHash {
+		size_t operator()(const PPU466::Tile &tile) const { return size_t(Checksum::of(&tile, sizeof(tile))); }
+	};
+	struct TileEqual {
+		bool operator()(const PPU466::Tile &a, const PPU466::Tile &b) const { return a.bit0 == b.bit0 && a.bit1 == b.bit1; }
+	};
+	std::unordered_map<PPU466::Tile, int, TileHash, TileEqual> tile_lookup;
+	uint32_t shared_tiles = 0, shared_by_flipping = 0;
+	std::vector<uint32_t> palette_sets; // color set of each entry of 'palettes'
+	for (const Cell &cell : cells) {
+		const std::string &name = cell.label;
+		int tile_index = -1;
+		int palette_index = -1;
+
+		// palettes are numbered in order of first use, which keeps the numbering stable as sprites are added:
+		const uint32_t set = color_set(cell.colors);
+		uint32_t palette_set = 0;
+		for (uint32_t candidate : packed) {
+			if ((set & ~candidate) == 0) {
+				palette_set = candidate;
+				break;
+			}
+		}
+		assert(palette_set != 0);
+		const auto used = std::find(palette_sets.begin(), palette_sets.end(), palette_set);
+		if (used != palette_sets.end()) {
+			palette_index = std::distance(palette_sets.begin(), used);
 		} else {
+			PPU466::Palette p;
+			// colors in canonical order (set bits in increasing order), zero-padded if there are fewer than 4:
+			p.fill(glm::u8vec4{0, 0, 0, 0});
+			uint32_t slot = 0;
+			for (uint32_t c = 0; c < all_colors.size(); ++c) {
+				if (palette_set & (1u << c)) p[slot++] = all_colors[c];
+			}
 			palettes.push_back(p);
+			palette_sets.push_back(palette_set);
 			palette_index = palettes.size() - 1;
-			if (palettes.size() > 8) {
-				throw AssetConversionException("Too many palettes, exceeds 8");
-			}
 		}
-		printf("palette idx for %s: %d\n", name.c_str(), palette_index);
-		// second pass: convert the png content to tiles
-		// TODO(xiaoqiao): is this zero initialization?
+		const PPU466::Palette &p = palettes[palette_index];
+		const bool verbose = (cell.entry == -1U); // (levels have thousands of cells; they aren't listed one by one)
+		for (uint32_t id : cell.colors) {
+			const glm::u8vec4 c = color_table[id];
+			if (verbose) printf("Colors used in %s: #%02hhx%02hhx%02hhx%02hhx\n", name.c_str(), c.x, c.y, c.z, c.w);
+		}
+		if (verbose) printf("palette idx for %s: %d\n", name.c_str(), palette_index);
+		// second pass: convert the cell's pixels to a tile
 		PPU466::Tile t{};
 		for (int i = 0; i < 8 * 8; i++) {
 			int row_idx = i / 8;
 			int col_idx = i % 8;
-			const auto &pix = img.data[i];
-			assert(std::find(p.begin(), p.end(), pix) != p.end());
-			int pixel_color_idx_in_palette = std::distance(p.begin(), std::find(p.begin(), p.end(), pix));
-			assert(pixel_color_idx_in_palette < 4);
+			// the palette lists its colors in number order, so a color's slot is how many of the palette's colors come before it:
+			const uint32_t n = number[cell.pixels[i]];
+			assert(palette_set & (1u << n));
+			int pixel_color_idx_in_palette = int(color_count(palette_set & ((1u << n) - 1)));
+			assert(pixel_color_idx_in_palette < 4 && p[pixel_color_idx_in_palette] == color_table[cell.pixels[i]]);
 			uint8_t bit0 = pixel_color_idx_in_palette & 1;
 			uint8_t bit1 = pixel_color_idx_in_palette >> 1;
 			t.bit0[row_idx] |= (bit0 << col_idx);
 			t.bit1[row_idx] |= (bit1 << col_idx);
  		}
-		tiles.push_back(t);
-		tile_index = tiles.size() - 1;
-		printf("tile idx for %s: %d\n", name.c_str(), tile_index);
-		if (tiles.size() > 16 * 16) {
-			throw AssetConversionException("Too many tiles: exceeds 16*16");
+		// share a stored tile if this one is the same or a mirror image of it (since the bits are
+		// indices into the canonically-ordered palette, tiles that differ only in palette match too):
+		uint8_t flip = 0;
+		for (uint8_t try_flip : {uint8_t(0), uint8_t(PPU466::FlipX), uint8_t(PPU466::FlipY), uint8_t(PPU466::FlipX | PPU466::FlipY)}) {
+			auto found = tile_lookup.find(t.flipped(try_flip));
+			if (found != tile_lookup.end()) {
+				tile_index = found->second;
+				flip = try_flip; // (flipping is its own inverse, so this flip of the stored tile gives t back)
+				break;
+			}
+		}
+		if (tile_index != -1) {
+			shared_tiles += 1;
+			if (flip) shared_by_flipping += 1;
+			if (verbose) printf("tile idx for %s: %d (shared, flip %d)\n", name.c_str(), tile_index, int(flip));
+		} else {
+			tiles.push_back(t);
+			tile_index = tiles.size() - 1;
+			tile_lookup.emplace(t, tile_index);
+			if (verbose) printf("tile idx for %s: %d\n", name.c_str(), tile_index);
+			if (tiles.size() > 16 * 16) {
+				throw AssetConversionException("Too many tiles: exceeds 16*16");
+			}
+		}
+		if (cell.entry != -1U) {
+			// (background entries are (flip | palette) << 8 | tile)
+			nametable[cell.entry] = uint16_t((flip | palette_index) << 8 | tile_index);
+		} else if (cell.part == -1U) {
+			mapping[name] = SpriteRef{tile_index, palette_index, flip};
+		} else {
+			parts[cell.part].index = uint8_t(tile_index);
+			parts[cell.part].attributes = uint8_t(palette_index | flip);
 		}
-		mapping[name] = std::make_pair(tile_index, palette_index);
 	}
-	return ProcessedSprites{std::move(tiles), std::move(palettes), std::move(mapping)};
+	std::cout << cells.size() << " tiles' worth of sprites and levels (" << mapping.size() << " sprites, " << metasprites.size() << " metasprites, "
+	          << levels.size() << " levels) use "
+	          << tiles.size() << " tiles: sharing saved " << shared_tiles
+	          << " of the 256 tile slots (" << shared_by_flipping << " by flipping)" << std::endl;
+	return ProcessedSprites{std::move(tiles), std::move(palettes), std::move(mapping),
+		std::move(parts), std::move(metasprites), std::move(metasprite_mapping),
+		std::move(levels), std::move(nametable), std::move(level_mapping)};
 }
 
 void store_sprite_resources(
 	const ProcessedSprites &sprites,
 	const std::string &output_chunk_dir,
-	const std::string &output_header_dir) {
+	const std::string &output_header_dir,
+	bool tile_texture) {
+	//(always both headers: the game's tiles come from assets_embedded.hpp, and they have to match the chunks written here)
 	store_sprite_header_file(sprites, output_header_dir);
-	store_sprite_chunk_file(sprites, output_chunk_dir);
+	store_embedded_header_file(sprites, output_header_dir);
+	store_sprite_chunk_file(sprites, output_chunk_dir, tile_texture);
 }
 
 void store_sprite_header_file(const ProcessedSprites &sprites, const std::string &output_header_dir) {
 	fs::create_directories(output_header_dir);
-	std::ofstream header_file_stream(output_header_dir + "/assets_res.h", std::ios::binary);
-	if (!header_file_stream) {
-		throw AssetConversionException("Error opening assets_res.h");
-	}
+	std::ostringstream header_file_stream;
 	header_file_stream << "#pragma once\n";
 	for (const auto &m : sprites.mapping) {
 		// write f"#define ${uppercase(resource_name)}_TILE_IDX ${tile_idx}\n"
 		header_file_stream << "#define ";
 		for (const char c : m.first) { header_file_stream << (char) toupper(c); }
-		header_file_stream << "_TILE_IDX " << m.second.first << "\n";
+		header_file_stream << "_TILE_IDX " << m.second.tile_index << "\n";
 		// write f"#define ${uppercase(resource_name)}_PALETTE_IDX ${palette_idx}\n"
 		header_file_stream << "#define ";
 		for (const char c : m.first) { header_file_stream << (char) toupper(c); }
-		header_file_stream << "_PALETTE_IDX " << m.second.second << "\n";
+		header_file_stream << "_PALETTE_IDX " << m.second.palette_index << "\n";
+		// write f"#define ${uppercase(resource_name)}_FLIP ${flip}\n" (PPU466::FlipX / FlipY bits)
+		header_file_stream << "#define ";
+		for (const char c : m.first) { header_file_stream << (char) toupper(c); }
+		header_file_stream << "_FLIP " << int(m.second.flip) << "\n";
 	}
-	if (header_file_stream.fail()) {
-		throw AssetConversionException("Error writing to assets_res.h");
+	for (const auto &m : sprites.metasprite_mapping) {
+		// write f"#define ${uppercase(resource_name)}_METASPRITE_IDX ${first}\n"
+		header_file_stream << "#define ";
+		for (const char c : m.first) { header_file_stream << (char) toupper(c); }
+		header_file_stream << "_METASPRITE_IDX " << m.second.first << "\n";
+		// write f"#define ${uppercase(resource_name)}_FRAMES ${frames}\n"
+		header_file_stream << "#define ";
+		for (const char c : m.first) { header_file_stream << (char) toupper(c); }
+		header_file_stream << "_FRAMES " << m.second.frames << "\n";
 	}
-	header_file_stream.close();
+	for (const auto &m : sprites.level_mapping) {
+		// write f"#define ${uppercase(level_name)}_LEVEL_IDX ${index}\n", and its _WIDTH and _HEIGHT in tiles:
+		header_file_stream << "#define ";
+		for (const char c : m.first) { header_file_stream << (char) toupper(c); }
+		header_file_stream << "_LEVEL_IDX " << m.second.index << "\n";
+		header_file_stream << "#define ";
+		for (const char c : m.first) { header_file_stream << (char) toupper(c); }
+		header_file_stream << "_LEVEL_WIDTH " << m.second.width << "\n";
+		header_file_stream << "#define ";
+		for (const char c : m.first) { header_file_stream << (char) toupper(c); }
+		header_file_stream << "_LEVEL_HEIGHT " << m.second.height << "\n";
+	}
+	write_if_changed(output_header_dir + "/assets_res.h", header_file_stream.str());
 }
 
-void store_sprite_chunk_file(const ProcessedSprites &sprites, const std::string &output_chunk_dir) {
-	fs::create_directories(output_chunk_dir);
-	std::ofstream tile_stream(output_chunk_dir + "/tiles.chunk", std::ios::binary);
-	std::ofstream palette_stream(output_chunk_dir + "/palettes.chunk", std::ios::binary);
-	if (!tile_stream || !palette_stream) {
-		throw AssetConversionException("error opening chunk files");
+void store_embedded_header_file(const ProcessedSprites &sprites, const std::string &output_header_dir) {
+	// resource name -> handle name (lowercased, and it had better be an identifier):
+	auto identifier = [](const std::string &name) {
+		std::string id;
+		for (const char c : name) id += char(tolower(c));
+		const bool ok = !id.empty() && !isdigit(id[0])
+			&& std::all_of(id.begin(), id.end(), [](char c) { return isalnum(c) || c == '_'; });
+		if (!ok) throw AssetConversionException("Resource name '" + name + "' can't be a C++ identifier, so it can't be embedded.");
+		return id;
+	};
+	auto hex = [](uint32_t value) {
+		std::ostringstream out;
+		out << "0x" << std::hex << (value < 0x10 ? "0" : "") << value;
+		return out.str();
+	};
+
+	fs::create_directories(output_header_dir);
+	std::ostringstream out;
+	out << "#pragma once\n"
+	    << "// generated by asset_pipe_converter: the converted tiles and palettes, compiled in,\n"
+	    << "// and a handle for each resource (each kind its own type, so using one as another doesn't compile)\n"
+	    << "\n"
+	    << "#include \"PPU466.hpp\"\n"
+	    << "\n"
+	    << "#include <array>\n"
+	    << "#include <cstdint>\n"
+	    << "#include <cstring>\n"
+	    << "\n"
+	    << "namespace assets {\n"
+	    << "\n"
+	    << "enum class TileIndex : uint8_t {};\n"
+	    << "enum class PaletteIndex : uint8_t {};\n"
+	    << "\n"
+	    << "struct Sprite {\n"
+	    << "\tTileIndex tile;\n"
+	    << "\tPaletteIndex palette;\n"
+	    << "\tuint8_t flip; // PPU466::FlipX / FlipY bits to show the (maybe shared) tile with\n"
+	    << "\t// for a PPU466::Sprite's index and attributes, and for a PPU466::background entry:\n"
+	    << "\tconstexpr uint8_t index() const { return uint8_t(tile); }\n"
+	    << "\tconstexpr uint8_t attributes() const { return uint8_t(uint8_t(palette) | flip); }\n"
+	    << "\tconstexpr uint16_t background_entry() const { return uint16_t(attributes() << 8 | index()); }\n"
+	    << "};\n"
+	    << "struct Metasprite {\n"
+	    << "\tuint32_t first; // index for Metasprites::request() of the first frame\n"
+	    << "\tuint32_t frames;\n"
+	    << "\tconstexpr uint32_t frame(uint32_t i) const { return first + i; }\n"
+	    << "};\n"
+	    << "struct Level {\n"
+	    << "\tuint32_t index; // for Levels::copy() and WorldStreamer\n"
+	    << "\tuint32_t width, height; // in tiles\n"
+	    << "};\n"
+	    << "\n";
+
+	// the tables:
+	out << "inline constexpr std::array< PPU466::Tile, " << sprites.tiles.size() << " > tiles = {{\n";
+	for (const auto &tile : sprites.tiles) {
+		out << "\t{{{";
+		for (uint32_t y = 0; y < 8; ++y) out << (y ? ", " : "") << hex(tile.bit0[y]);
+		out << "}}, {{";
+		for (uint32_t y = 0; y < 8; ++y) out << (y ? ", " : "") << hex(tile.bit1[y]);
+		out << "}}},\n";
+	}
+	out << "}};\n"
+	    << "\n"
+	    << "// (RGBA bytes: glm vectors can't be relied on to be constexpr)\n"
+	    << "inline constexpr std::array< std::array< uint8_t, 4 * 4 >, " << sprites.palettes.size() << " > palettes = {{\n";
+	for (const auto &palette : sprites.palettes) {
+		out << "\t{{";
+		for (uint32_t c = 0; c < 4; ++c) {
+			for (uint32_t i = 0; i < 4; ++i) out << (c || i ? ", " : "") << hex(palette[c][i]);
+		}
+		out << "}},\n";
+	}
+	out << "}};\n"
+	    << "static_assert(palettes.size() <= 8, \"palettes fit the palette table\");\n"
+	    << "\n"
+	    << "// copy the palettes into a PPU's palette table (palettes past the converted ones are left alone):\n"
+	    << "inline void copy_palettes(std::array< PPU466::Palette, 8 > *palette_table) {\n"
+	    << "\tstatic_assert(sizeof(PPU466::Palette) == 4 * 4, \"palette is packed\");\n"
+	    << "\tfor (uint32_t i = 0; i < palettes.size(); ++i) {\n"
+	    << "\t\tstd::memcpy(&(*palette_table)[i], palettes[i].data(), sizeof(PPU466::Palette));\n"
+	    << "\t}\n"
+	    << "}\n"
+	    << "\n";
+
+	// the handles:
+	out << "namespace sprites {\n";
+	for (const auto &[name, ref] : sprites.mapping) {
+		out << "\tinline constexpr Sprite " << identifier(name) << "{TileIndex(" << ref.tile_index << "), PaletteIndex(" << ref.palette_index << "), " << int(ref.flip) << "};\n";
 	}
+	out << "}\n"
+	    << "namespace metasprites {\n";
+	for (const auto &[name, ref] : sprites.metasprite_mapping) {
+		out << "\tinline constexpr Metasprite " << identifier(name) << "{" << ref.first << ", " << ref.frames << "};\n";
+	}
+	out << "}\n"
+	    << "namespace levels {\n";
+	for (const auto &[name, ref] : sprites.level_mapping) {
+		out << "\tinline constexpr Level " << identifier(name) << "{" << ref.index << ", " << ref.width << ", " << ref.height << "};\n";
+	}
+	out << "}\n"
+	    << "\n"
+	    << "} // namespace assets\n";
+	write_if_changed(output_header_dir + "/assets_embedded.hpp", out.str());
+}
+
+void store_sprite_chunk_file(const ProcessedSprites &sprites, const std::string &output_chunk_dir, bool tile_texture) {
+	fs::create_directories(output_chunk_dir);
+	std::ostringstream tile_stream;
+	std::ostringstream palette_stream;
 	write_chunk("til0", sprites.tiles, &tile_stream);
 	write_chunk("plt0", sprites.palettes, &palette_stream);
-	if (tile_stream.fail() || palette_stream.fail()) {
-		throw AssetConversionException("error writing chunk files");
+	write_if_changed(output_chunk_dir + "/tiles.chunk", tile_stream.str());
+	write_if_changed(output_chunk_dir + "/palettes.chunk", palette_stream.str());
+	// (written even if there are no metasprites, so Metasprites::load() always has a file to read)
+	std::ostringstream metasprite_stream;
+	write_chunk("msp0", sprites.metasprites, &metasprite_stream);
+	write_chunk("mpt0", sprites.parts, &metasprite_stream);
+	write_if_changed(output_chunk_dir + "/metasprites.chunk", metasprite_stream.str());
+	std::ostringstream level_stream;
+	write_chunk("lvl0", sprites.levels, &level_stream);
+	write_chunk("nmt0", sprites.nametable, &level_stream);
+	write_if_changed(output_chunk_dir + "/levels.chunk", level_stream.str());
+	if (tile_texture) {
+		// the whole 256-tile table (blank past the converted tiles), and the texture it unpacks to:
+		std::vector<PPU466::Tile> table(16 * 16, PPU466::Tile{});
+		std::copy(sprites.tiles.begin(), sprites.tiles.end(), table.begin());
+		std::vector<uint8_t> texels(PPU466::TileTextureSize * PPU466::TileTextureSize, 0);
+		for (uint32_t i = 0; i < table.size(); ++i) {
+			PPU466::unpack_tile(table[i], i, texels.data());
+		}
+		std::ostringstream texture_stream;
+		write_chunk("ttl0", table, &texture_stream);
+		write_chunk("ttx0", texels, &texture_stream);
+		write_if_changed(output_chunk_dir + "/tile_texture.chunk", texture_stream.str());
 	}
 }
 
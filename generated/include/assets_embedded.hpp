@@ -0,0 +1,102 @@
+#pragma once
+// generated by asset_pipe_converter: the converted tiles and palettes, compiled in,
+// and a handle for each resource (each kind its own type, so using one as another doesn't compile)
+
+#include "PPU466.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace assets {
+
+enum class TileIndex : uint8_t {};
+enum class PaletteIndex : uint8_t {};
+
+struct Sprite {
+	TileIndex tile;
+	PaletteIndex palette;
+	uint8_t flip; // PPU466::FlipX / FlipY bits to show the (maybe shared) tile with
+	// for a PPU466::Sprite's index and attributes, and for a PPU466::background entry:
+	constexpr uint8_t index() const { return uint8_t(tile); }
+	constexpr uint8_t attributes() const { return uint8_t(uint8_t(palette) | flip); }
+	constexpr uint16_t background_entry() const { return uint16_t(attributes() << 8 | index()); }
+};
+struct Metasprite {
+	uint32_t first; // index for Metasprites::request() of the first frame
+	uint32_t frames;
+	constexpr uint32_t frame(uint32_t i) const { return first + i; }
+};
+struct Level {
+	uint32_t index; // for Levels::copy() and WorldStreamer
+	uint32_t width, height; // in tiles
+};
+
+inline constexpr std::array< PPU466::Tile, 18 > tiles = {{
+	{{{0x00, 0x00, 0x04, 0x04, 0x00, 0x04, 0x04, 0x04}}, {{0x9e, 0xff, 0xfb, 0xda, 0x8c, 0x04, 0x04, 0x04}}},
+	{{{0x0c, 0x16, 0x3d, 0x3d, 0x1a, 0xac, 0x48, 0xb0}}, {{0x00, 0x08, 0x02, 0x02, 0x04, 0x00, 0x00, 0x00}}},
+	{{{0x60, 0x30, 0x18, 0x1c, 0x1c, 0x1c, 0x38, 0x70}}, {{0x10, 0x08, 0x04, 0x00, 0x00, 0x04, 0x08, 0x10}}},
+	{{{0xfc, 0x02, 0xbd, 0xb1, 0xce, 0x30, 0x40, 0x80}}, {{0x00, 0xfc, 0xfe, 0xfe, 0xf0, 0xc0, 0x80, 0x00}}},
+	{{{0x7f, 0x80, 0xb1, 0x4c, 0x2a, 0x17, 0x08, 0x07}}, {{0x00, 0x7f, 0x7f, 0x3f, 0x1f, 0x0f, 0x07, 0x00}}},
+	{{{0x3c, 0x24, 0x24, 0x3c, 0x24, 0x24, 0x3c, 0x00}}, {{0x00, 0x18, 0x18, 0x00, 0x18, 0x18, 0x00, 0x00}}},
+	{{{0x30, 0x0c, 0x18, 0x96, 0x97, 0x18, 0x0c, 0x30}}, {{0x38, 0x1c, 0xbe, 0xff, 0xfd, 0xbe, 0x1c, 0x38}}},
+	{{{0x3c, 0x20, 0x20, 0x3c, 0x04, 0x04, 0x3c, 0x00}}, {{0x00, 0x1c, 0x1c, 0x00, 0x38, 0x38, 0x00, 0x00}}},
+	{{{0x10, 0x10, 0x10, 0x3e, 0x14, 0x18, 0x10, 0x00}}, {{0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00}}},
+	{{{0x3c, 0x20, 0x20, 0x3c, 0x24, 0x24, 0x3c, 0x00}}, {{0x00, 0x1c, 0x1c, 0x00, 0x18, 0x18, 0x00, 0x00}}},
+	{{{0x7c, 0x10, 0x10, 0x10, 0x14, 0x18, 0x10, 0x00}}, {{0x00, 0x6c, 0x6c, 0x6c, 0x68, 0x64, 0x6c, 0x00}}},
+	{{{0x08, 0x08, 0x10, 0x10, 0x20, 0x20, 0x3c, 0x00}}, {{0x34, 0x34, 0x2c, 0x2c, 0x1c, 0x1c, 0x00, 0x00}}},
+	{{{0x3c, 0x24, 0x24, 0x3c, 0x04, 0x04, 0x3c, 0x00}}, {{0x00, 0x18, 0x18, 0x00, 0x38, 0x38, 0x00, 0x00}}},
+	{{{0x3c, 0x20, 0x20, 0x3c, 0x20, 0x20, 0x3c, 0x00}}, {{0x00, 0x1c, 0x1c, 0x00, 0x1c, 0x1c, 0x00, 0x00}}},
+	{{{0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}}, {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}}},
+	{{{0xff, 0xff, 0xff, 0xff, 0xe7, 0xdb, 0x81, 0x00}}, {{0x00, 0x00, 0x00, 0x00, 0x18, 0x3c, 0x42, 0x81}}},
+	{{{0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}}, {{0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}}},
+	{{{0x3c, 0x24, 0x24, 0x24, 0x24, 0x24, 0x3c, 0x00}}, {{0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00}}},
+}};
+
+// (RGBA bytes: glm vectors can't be relied on to be constexpr)
+inline constexpr std::array< std::array< uint8_t, 4 * 4 >, 5 > palettes = {{
+	{{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x18, 0x3f, 0x39, 0xff, 0x3c, 0x9f, 0x9c, 0xff}},
+	{{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00}},
+	{{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x2a, 0x1d, 0x0d, 0xff, 0x92, 0x7e, 0x6a, 0xff}},
+	{{0x00, 0x00, 0x00, 0x00, 0x72, 0xbf, 0xff, 0xff, 0xc1, 0xe3, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}},
+	{{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xef, 0x3a, 0x0c, 0xff, 0xef, 0xac, 0x28, 0xff}},
+}};
+static_assert(palettes.size() <= 8, "palettes fit the palette table");
+
+// copy the palettes into a PPU's palette table (palettes past the converted ones are left alone):
+inline void copy_palettes(std::array< PPU466::Palette, 8 > *palette_table) {
+	static_assert(sizeof(PPU466::Palette) == 4 * 4, "palette is packed");
+	for (uint32_t i = 0; i < palettes.size(); ++i) {
+		std::memcpy(&(*palette_table)[i], palettes[i].data(), sizeof(PPU466::Palette));
+	}
+}
+
+namespace sprites {
+	inline constexpr Sprite whale{TileIndex(0), PaletteIndex(0), 0};
+	inline constexpr Sprite bomb{TileIndex(1), PaletteIndex(1), 0};
+	inline constexpr Sprite boomerang_left{TileIndex(2), PaletteIndex(2), 0};
+	inline constexpr Sprite boomerang_right{TileIndex(2), PaletteIndex(2), 64};
+	inline constexpr Sprite cloud_left{TileIndex(3), PaletteIndex(3), 0};
+	inline constexpr Sprite cloud_right{TileIndex(4), PaletteIndex(3), 0};
+	inline constexpr Sprite eight{TileIndex(5), PaletteIndex(1), 0};
+	inline constexpr Sprite fish{TileIndex(6), PaletteIndex(4), 0};
+	inline constexpr Sprite five{TileIndex(7), PaletteIndex(1), 0};
+	inline constexpr Sprite four{TileIndex(8), PaletteIndex(1), 0};
+	inline constexpr Sprite nine{TileIndex(9), PaletteIndex(1), 0};
+	inline constexpr Sprite one{TileIndex(10), PaletteIndex(1), 0};
+	inline constexpr Sprite seven{TileIndex(11), PaletteIndex(1), 0};
+	inline constexpr Sprite six{TileIndex(12), PaletteIndex(1), 0};
+	inline constexpr Sprite three{TileIndex(13), PaletteIndex(1), 0};
+	inline constexpr Sprite two{TileIndex(7), PaletteIndex(1), 64};
+	inline constexpr Sprite wave_down{TileIndex(14), PaletteIndex(3), 0};
+	inline constexpr Sprite wave_up{TileIndex(15), PaletteIndex(3), 0};
+	inline constexpr Sprite white{TileIndex(16), PaletteIndex(3), 0};
+	inline constexpr Sprite zero{TileIndex(17), PaletteIndex(1), 0};
+}
+namespace metasprites {
+}
+namespace levels {
+	inline constexpr Level sea{0, 64, 60};
+}
+
+} // namespace assets
@@ -1,41 +1,64 @@
 #pragma once
 #define WHALE_TILE_IDX 0
 #define WHALE_PALETTE_IDX 0
+#define WHALE_FLIP 0
 #define BOMB_TILE_IDX 1
 #define BOMB_PALETTE_IDX 1
+#define BOMB_FLIP 0
 #define BOOMERANG_LEFT_TILE_IDX 2
 #define BOOMERANG_LEFT_PALETTE_IDX 2
-#define BOOMERANG_RIGHT_TILE_IDX 3
+#define BOOMERANG_LEFT_FLIP 0
+#define BOOMERANG_RIGHT_TILE_IDX 2
 #define BOOMERANG_RIGHT_PALETTE_IDX 2
-#define CLOUD_LEFT_TILE_IDX 4
+#define BOOMERANG_RIGHT_FLIP 64
+#define CLOUD_LEFT_TILE_IDX 3
 #define CLOUD_LEFT_PALETTE_IDX 3
-#define CLOUD_RIGHT_TILE_IDX 5
+#define CLOUD_LEFT_FLIP 0
+#define CLOUD_RIGHT_TILE_IDX 4
 #define CLOUD_RIGHT_PALETTE_IDX 3
-#define EIGHT_TILE_IDX 6
+#define CLOUD_RIGHT_FLIP 0
+#define EIGHT_TILE_IDX 5
 #define EIGHT_PALETTE_IDX 1
-#define FISH_TILE_IDX 7
+#define EIGHT_FLIP 0
+#define FISH_TILE_IDX 6
 #define FISH_PALETTE_IDX 4
-#define FIVE_TILE_IDX 8
+#define FISH_FLIP 0
+#define FIVE_TILE_IDX 7
 #define FIVE_PALETTE_IDX 1
-#define FOUR_TILE_IDX 9
+#define FIVE_FLIP 0
+#define FOUR_TILE_IDX 8
 #define FOUR_PALETTE_IDX 1
-#define NINE_TILE_IDX 10
+#define FOUR_FLIP 0
+#define NINE_TILE_IDX 9
 #define NINE_PALETTE_IDX 1
-#define ONE_TILE_IDX 11
+#define NINE_FLIP 0
+#define ONE_TILE_IDX 10
 #define ONE_PALETTE_IDX 1
-#define SEVEN_TILE_IDX 12
+#define ONE_FLIP 0
+#define SEVEN_TILE_IDX 11
 #define SEVEN_PALETTE_IDX 1
-#define SIX_TILE_IDX 13
+#define SEVEN_FLIP 0
+#define SIX_TILE_IDX 12
 #define SIX_PALETTE_IDX 1
-#define THREE_TILE_IDX 14
+#define SIX_FLIP 0
+#define THREE_TILE_IDX 13
 #define THREE_PALETTE_IDX 1
-#define TWO_TILE_IDX 15
+#define THREE_FLIP 0
+#define TWO_TILE_IDX 7
 #define TWO_PALETTE_IDX 1
-#define WAVE_DOWN_TILE_IDX 16
-#define WAVE_DOWN_PALETTE_IDX 5
-#define WAVE_UP_TILE_IDX 17
+#define TWO_FLIP 64
+#define WAVE_DOWN_TILE_IDX 14
+#define WAVE_DOWN_PALETTE_IDX 3
+#define WAVE_DOWN_FLIP 0
+#define WAVE_UP_TILE_IDX 15
 #define WAVE_UP_PALETTE_IDX 3
-#define WHITE_TILE_IDX 18
-#define WHITE_PALETTE_IDX 6
-#define ZERO_TILE_IDX 19
+#define WAVE_UP_FLIP 0
+#define WHITE_TILE_IDX 16
+#define WHITE_PALETTE_IDX 3
+#define WHITE_FLIP 0
+#define ZERO_TILE_IDX 17
 #define ZERO_PALETTE_IDX 1
+#define ZERO_FLIP 0
+#define SEA_LEVEL_IDX 0
+#define SEA_LEVEL_WIDTH 64
+#define SEA_LEVEL_HEIGHT 60
@@ -26,6 +26,22 @@ void load_png(std::string filename, glm::uvec2 *size, std::vector< glm::u8vec4 >
 	}
 }
 
+void load_png(std::string const &name, std::string const &bytes, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin) {
+	assert(size);
+
+	//read straight out of 'bytes' (no copy):
+	struct BytesBuf : std::streambuf {
+		BytesBuf(std::string const &bytes) {
+			char *begin = const_cast< char * >(bytes.data()); //(only ever read)
+			setg(begin, begin, begin + bytes.size());
+		}
+	} buf(bytes);
+	std::istream from(&buf);
+	if (!load_png(from, &size->x, &size->y, data, origin)) {
+		throw std::runtime_error("Failed to read PNG image from '" + name + "'.");
+	}
+}
+
 void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, OriginLocation origin) {
 	std::ofstream file(filename.c_str(), std::ios::binary);
 	save_png(file, size.x, size.y, data, origin);
@@ -22,6 +22,8 @@
 #include <stdexcept>
 #include <memory>
 #include <algorithm>
+#include <cmath>
+#include <string>
 
 int main(int argc, char **argv) {
 #ifdef _WIN32
@@ -29,6 +31,82 @@ int main(int argc, char **argv) {
 	try {
 #endif
 
+	//------------  command line ------------
+
+	//By default, 'update' is called once per frame with the (clamped) wall-clock time since the last frame.
+	//With '--tick-rate <hz>', 'update' is instead called with fixed-size steps of 1/hz seconds,
+	// as many as are needed to catch up to the wall clock (but at most '--max-ticks-per-frame <n>' per frame):
+	float tick_rate = 0.0f; //0 means "variable-size steps"
+	uint32_t max_ticks_per_frame = 5;
+
+	//With '--record <file>', every input and update is recorded to <file> (see Replay.hpp),
+	// which can be played back and checked headlessly with 'play_replay <file>':
+	std::string record_filename;
+
+	//With '--snapshot <file>', F5 saves a snapshot of the session to <file> and F9 loads it (see Snapshot.hpp);
+	// with '--restore <file>', play starts from the snapshot in <file>:
+	std::string snapshot_filename;
+	std::string restore_filename;
+
+	//With '--checksum-log <file>', the game and PPU checksums of every drawn frame are written to <file>:
+	std::string checksum_log_filename;
+
+	//With '--scanline-limit <n>', the PPU only shows n sprites on any one scanline (like the NES's eight);
+	// with '--overflow-report <n>', frames that would go over n sprites on a scanline are reported (see PlayMode.hpp):
+	uint32_t scanline_limit = 0;
+	uint32_t overflow_report_limit = 0;
+
+	auto usage = [&argv]() {
+		std::cerr << "Usage:\n\t" << argv[0] << " [--tick-rate <hz>] [--max-ticks-per-frame <n>] [--record <file>] [--snapshot <file>] [--restore <file>] [--checksum-log <file>] [--scanline-limit <n>] [--overflow-report <n>]" << std::endl;
+	};
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		//(every option takes a value)
+		if (!(arg == "--tick-rate" || arg == "--max-ticks-per-frame" || arg == "--record" || arg == "--snapshot"
+		 || arg == "--restore" || arg == "--checksum-log" || arg == "--scanline-limit" || arg == "--overflow-report")) {
+			//launchers and debuggers sometimes pass arguments of their own (e.g., macOS's -psn_*), so just skip these:
+			std::cerr << "Ignoring unknown argument '" << arg << "'." << std::endl;
+			continue;
+		}
+		if (argi + 1 >= argc) {
+			std::cerr << arg << " needs a value." << std::endl;
+			usage();
+			return 1;
+		}
+		std::string value = argv[++argi];
+		try {
+			if (arg == "--tick-rate") {
+				tick_rate = std::stof(value);
+			} else if (arg == "--max-ticks-per-frame") {
+				max_ticks_per_frame = uint32_t(std::stoul(value));
+			} else if (arg == "--record") {
+				record_filename = value;
+			} else if (arg == "--snapshot") {
+				snapshot_filename = value;
+			} else if (arg == "--restore") {
+				restore_filename = value;
+			} else if (arg == "--checksum-log") {
+				checksum_log_filename = value;
+			} else if (arg == "--scanline-limit") {
+				scanline_limit = uint32_t(std::stoul(value));
+			} else if (arg == "--overflow-report") {
+				overflow_report_limit = uint32_t(std::stoul(value));
+			}
+		} catch (std::logic_error const &) { //(std::invalid_argument or std::out_of_range from the number parsing)
+			std::cerr << "Bad value '" << value << "' for " << arg << "." << std::endl;
+			usage();
+			return 1;
+		}
+	}
+	if (tick_rate < 0.0f || max_ticks_per_frame == 0) {
+		std::cerr << "--tick-rate must be non-negative and --max-ticks-per-frame must be positive." << std::endl;
+		return 1;
+	}
+	if (!record_filename.empty() && !restore_filename.empty()) {
+		std::cerr << "--record and --restore can't be used together (recordings start from a fresh session)." << std::endl;
+		return 1;
+	}
+
 	//------------  initialization ------------
 
 	//Initialize SDL library:
@@ -93,7 +171,16 @@ int main(int argc, char **argv) {
 	call_load_functions();
 
 	//------------ create game mode + make current --------------
-	Mode::set_current(std::make_shared< PlayMode >());
+	{
+		auto play_mode = std::make_shared< PlayMode >();
+		if (!restore_filename.empty()) play_mode->load_snapshot(restore_filename);
+		if (!record_filename.empty()) play_mode->start_recording(record_filename);
+		play_mode->snapshot_filename = snapshot_filename;
+		if (!checksum_log_filename.empty()) play_mode->start_checksum_log(checksum_log_filename);
+		play_mode->ppu.sprites_per_scanline = scanline_limit;
+		play_mode->overflow_report_limit = overflow_report_limit;
+		Mode::set_current(play_mode);
+	}
 
 	//------------ main loop ------------
 
@@ -155,12 +242,37 @@ int main(int argc, char **argv) {
 			float elapsed = std::chrono::duration< float >(current_time - previous_time).count();
 			previous_time = current_time;
 
-			//if frames are taking a very long time to process,
-			//lag to avoid spiral of death:
-			elapsed = std::min(0.1f, elapsed);
+			if (tick_rate == 0.0f) {
+				//if frames are taking a very long time to process,
+				//lag to avoid spiral of death:
+				elapsed = std::min(0.1f, elapsed);
+
+				Mode::current->update(elapsed);
+				if (!Mode::current) break;
+				Mode::current->tick_alpha = 1.0f;
+			} else {
+				//run as many fixed-size steps as fit in the time accumulated so far:
+				const float tick = 1.0f / tick_rate;
+				static float accumulated = 0.0f;
+				accumulated += elapsed;
+
+				uint32_t ticks = 0;
+				while (accumulated >= tick && ticks < max_ticks_per_frame) {
+					Mode::current->update(tick);
+					if (!Mode::current) break;
+					accumulated -= tick;
+					ticks += 1;
+				}
+				if (!Mode::current) break;
 
-			Mode::current->update(elapsed);
-			if (!Mode::current) break;
+				//if frames are taking a very long time to process,
+				//drop whole steps instead of trying to catch up (avoids spiral of death):
+				if (accumulated >= tick) {
+					accumulated = std::fmod(accumulated, tick);
+				}
+
+				Mode::current->tick_alpha = accumulated / tick;
+			}
 		}
 
 		{ //(3) call the current mode's "draw" function to produce output:
@@ -0,0 +1,169 @@
+//monte_carlo plays thousands of independent, seeded sessions headlessly (using every core)
+// with a scripted player, then reports the distribution of final scores.
+//Use it to see how changes to spawn counts, gravity, or point values shift scores without playtesting.
+//
+//usage:
+//  ./dist/monte_carlo [--sessions <n>] [--threads <n>] [--seed <n>] [--tick-rate <hz>]
+//                     [--min-hold <seconds>] [--max-hold <seconds>]
+//                     [--fish <n>] [--whales <n>] [--bombs <n>] [--gravity <px/s^2>] [--spawn-chance <p>]
+//                     [--fish-points <n>] [--whale-points <n>] [--bomb-points <n>] [--session-length <seconds>]
+
+#include "GameState.hpp"
+#include "ScriptedPlayer.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//seeds for session 's' of the batch started with 'seed':
+// (one splitmix64 step over (seed, s) -- a bijection on 64 bits -- so every (seed, s) gets its own pair of seeds,
+//  and batches with different --seed values don't share sessions)
+static void session_seeds(uint32_t seed, uint32_t s, uint32_t *game_seed, uint32_t *player_seed) {
+	uint64_t z = ((uint64_t(seed) << 32) | s) + 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	z = z ^ (z >> 31);
+	*game_seed = uint32_t(z);
+	*player_seed = uint32_t(z >> 32);
+}
+
+int main(int argc, char **argv) {
+	uint32_t sessions = 10000;
+	uint32_t threads = 0; //0 = one per hardware thread
+	uint32_t seed = 1;
+	float tick_rate = 60.0f;
+	float min_hold = 0.1f;
+	float max_hold = 1.0f;
+	GameState::Tuning tuning;
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (argi + 1 >= argc) arg = "--help"; //every option takes a value
+		if (arg == "--sessions") {
+			sessions = uint32_t(std::stoul(argv[++argi]));
+		} else if (arg == "--threads") {
+			threads = uint32_t(std::stoul(argv[++argi]));
+		} else if (arg == "--seed") {
+			seed = uint32_t(std::stoul(argv[++argi]));
+		} else if (arg == "--tick-rate") {
+			tick_rate = std::stof(argv[++argi]);
+		} else if (arg == "--min-hold") {
+			min_hold = std::stof(argv[++argi]);
+		} else if (arg == "--max-hold") {
+			max_hold = std::stof(argv[++argi]);
+		} else if (arg == "--fish") {
+			tuning.num_fish = uint8_t(std::stoul(argv[++argi]));
+		} else if (arg == "--whales") {
+			tuning.num_whale = uint8_t(std::stoul(argv[++argi]));
+		} else if (arg == "--bombs") {
+			tuning.num_bomb = uint8_t(std::stoul(argv[++argi]));
+		} else if (arg == "--gravity") {
+			tuning.gravity = std::stof(argv[++argi]);
+		} else if (arg == "--spawn-chance") {
+			tuning.spawn_chance = std::stof(argv[++argi]);
+		} else if (arg == "--fish-points") {
+			tuning.fish_points = std::stoi(argv[++argi]);
+		} else if (arg == "--whale-points") {
+			tuning.whale_points = std::stoi(argv[++argi]);
+		} else if (arg == "--bomb-points") {
+			tuning.bomb_points = std::stoi(argv[++argi]);
+		} else if (arg == "--session-length") {
+			tuning.session_length = std::stod(argv[++argi]);
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--sessions <n>] [--threads <n>] [--seed <n>] [--tick-rate <hz>]\n"
+			             "\t\t[--min-hold <seconds>] [--max-hold <seconds>]\n"
+			             "\t\t[--fish <n>] [--whales <n>] [--bombs <n>] [--gravity <px/s^2>] [--spawn-chance <p>]\n"
+			             "\t\t[--fish-points <n>] [--whale-points <n>] [--bomb-points <n>] [--session-length <seconds>]" << std::endl;
+			return 1;
+		}
+	}
+	if (sessions == 0 || tick_rate <= 0.0f || min_hold > max_hold) {
+		std::cerr << "Need --sessions > 0, --tick-rate > 0, and --min-hold <= --max-hold." << std::endl;
+		return 1;
+	}
+	const float elapsed = 1.0f / tick_rate;
+
+	//the only thing sessions share is this (read-only) tile table:
+	const std::vector< PPU466::Tile > tiles = GameState::load_tiles();
+
+	std::vector< int > scores(sessions, 0);
+	std::vector< uint64_t > ticks_run(sessions, 0);
+
+	ThreadPool pool(threads);
+
+	auto before = std::chrono::high_resolution_clock::now();
+
+	for (uint32_t s = 0; s < sessions; ++s) {
+		pool.run([&, s](uint32_t) {
+			//session 's' is fully determined by (seed, s):
+			uint32_t game_seed, player_seed;
+			session_seeds(seed, s, &game_seed, &player_seed);
+			GameState game(tiles, tuning, game_seed);
+			ScriptedPlayer player(min_hold, max_hold, player_seed);
+			uint64_t ticks = 0;
+			while (!game.game_stop) {
+				player.drive(game, elapsed);
+				game.update(elapsed);
+				ticks += 1;
+			}
+			scores[s] = game.score;
+			ticks_run[s] = ticks;
+		});
+	}
+	pool.wait();
+
+	auto after = std::chrono::high_resolution_clock::now();
+	double wall = std::chrono::duration< double >(after - before).count();
+
+	uint64_t total_ticks = 0;
+	for (uint64_t t : ticks_run) total_ticks += t;
+
+	//---- score distribution ----
+	std::vector< int > sorted = scores;
+	std::sort(sorted.begin(), sorted.end());
+
+	double mean = 0.0;
+	for (int score : sorted) mean += score;
+	mean /= double(sorted.size());
+	double variance = 0.0;
+	for (int score : sorted) variance += (score - mean) * (score - mean);
+	variance /= double(sorted.size());
+
+	auto percentile = [&sorted](double p) -> int {
+		size_t i = size_t(std::round(p * double(sorted.size() - 1)));
+		return sorted[i];
+	};
+
+	std::cout << sessions << " sessions on " << pool.size() << " threads in " << wall << " seconds\n";
+	std::cout << "  " << (double(sessions) / wall) << " sessions per second, "
+	          << (double(total_ticks) * double(elapsed) / wall) << " simulated seconds per wall second\n";
+	std::cout << "tuning: fish " << int(tuning.num_fish) << ", whales " << int(tuning.num_whale) << ", bombs " << int(tuning.num_bomb)
+	          << ", gravity " << tuning.gravity << ", spawn chance " << tuning.spawn_chance
+	          << ", points " << tuning.fish_points << "/" << tuning.whale_points << "/" << tuning.bomb_points
+	          << ", length " << tuning.session_length << "s\n";
+	std::cout << "score: mean " << mean << ", stddev " << std::sqrt(variance)
+	          << ", min " << sorted.front() << ", p10 " << percentile(0.1) << ", median " << percentile(0.5)
+	          << ", p90 " << percentile(0.9) << ", max " << sorted.back() << "\n";
+
+	{ //text histogram, about 20 bins wide:
+		int lo = sorted.front();
+		int hi = sorted.back();
+		int width = std::max(1, (hi - lo + 20) / 20);
+		std::vector< uint32_t > bins((hi - lo) / width + 1, 0);
+		for (int score : sorted) bins[(score - lo) / width] += 1;
+		uint32_t tallest = *std::max_element(bins.begin(), bins.end());
+		for (uint32_t b = 0; b < bins.size(); ++b) {
+			int bin_lo = lo + int(b) * width;
+			std::cout << std::setw(6) << bin_lo << " .. " << std::setw(6) << (bin_lo + width - 1) << " | "
+			          << std::setw(7) << bins[b] << " " << std::string(50 * bins[b] / tallest, '#') << "\n";
+		}
+	}
+	std::cout.flush();
+
+	return 0;
+}
@@ -0,0 +1,239 @@
+//netplay runs one peer of a two-player versus session (see RollbackSession.hpp) over UDP on localhost,
+// with each player's input coming from a ScriptedPlayer, and checks that both peers end up in the same state.
+//Start both peers at about the same time (e.g., in two terminals):
+//  ./dist/netplay --player 0 --port 7000 --peer-port 7001 --latency 50 --loss 0.1
+//  ./dist/netplay --player 1 --port 7001 --peer-port 7000 --latency 50 --loss 0.1
+//
+//With --bench, it instead measures the cost of re-simulation (no network needed):
+//  ./dist/netplay --bench [--boomerangs <n>]
+//
+//usage:
+//  ./dist/netplay --player <0|1> --port <port> --peer-port <port> [--frames <n>] [--seed <n>]
+//                 [--latency <ms>] [--jitter <ms>] [--loss <fraction>] [--min-hold <seconds>] [--max-hold <seconds>]
+//  ./dist/netplay --bench [--frames <n>] [--seed <n>] [--boomerangs <n>]
+
+#include "RollbackSession.hpp"
+#include "ScriptedPlayer.hpp"
+#include "UdpSocket.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <thread>
+
+//sent (repeatedly) once a peer has simulated every frame with confirmed inputs:
+struct DonePacket {
+	uint32_t magic = 0x72626431; //"rbd1"
+	uint32_t frames = 0;
+	uint64_t checksum = 0;
+	int32_t scores[2] = {0, 0};
+};
+static_assert(sizeof(DonePacket) == 24, "DonePacket is packed");
+static_assert(sizeof(DonePacket) == sizeof(RollbackSession::Packet), "packets are told apart by magic number");
+
+static const float Elapsed = 1.0f / 60.0f; //fixed step per frame
+
+static int bench(std::vector< PPU466::Tile > const &tiles, uint32_t frames, uint32_t seed, uint32_t boomerangs) {
+	typedef std::chrono::high_resolution_clock Clock;
+	auto microseconds = [](Clock::duration d) { return std::chrono::duration< double, std::micro >(d).count(); };
+
+	VersusState start(tiles, GameState::Tuning(), seed);
+	for (auto &player : start.players) player.boomerang_limit = boomerangs;
+
+	//two sessions, passing packets to each other as late as possible without stalling:
+	// (so mispredictions cost deep rollbacks)
+	RollbackSession sessions[2] = {
+		RollbackSession(start, 0, Elapsed),
+		RollbackSession(start, 1, Elapsed)
+	};
+	ScriptedPlayer players[2] = {
+		ScriptedPlayer(0.05f, 0.5f, seed + 1),
+		ScriptedPlayer(0.05f, 0.5f, seed + 2)
+	};
+	std::deque< RollbackSession::Packet > in_flight[2];
+
+	double advance_total = 0.0, advance_worst = 0.0;
+	double forced_total = 0.0, forced_worst = 0.0;
+	uint32_t forced = 0;
+
+	for (uint32_t f = 0; f < frames; ++f) {
+		for (uint32_t p = 0; p < 2; ++p) {
+			in_flight[1-p].emplace_back(sessions[p].make_packet());
+		}
+		for (uint32_t p = 0; p < 2; ++p) {
+			RollbackSession &session = sessions[p];
+			if (in_flight[p].size() > RollbackSession::MaxRollback - 1) {
+				session.receive_packet(in_flight[p].front());
+				in_flight[p].pop_front();
+			}
+
+			bool pressed = players[p].next(Elapsed);
+			auto before = Clock::now();
+			bool advanced = session.advance(pressed);
+			double took = microseconds(Clock::now() - before);
+			if (!advanced) {
+				std::cerr << "Unexpected stall in benchmark." << std::endl;
+				return 1;
+			}
+			advance_total += took;
+			advance_worst = std::max(advance_worst, took);
+		}
+
+		//worst case: pretend the oldest frame still open was mispredicted:
+		// (re-simulating with the same inputs gives the same state, so this doesn't change the run)
+		RollbackSession &session = sessions[0];
+		if (session.frame >= RollbackSession::MaxRollback) {
+			RollbackSession::Stats stats = session.stats; //(keep forced rollbacks out of the statistics)
+			session.rollback_from = session.frame - RollbackSession::MaxRollback;
+			auto before = Clock::now();
+			session.resolve();
+			double took = microseconds(Clock::now() - before);
+			session.stats = stats;
+			forced_total += took;
+			forced_worst = std::max(forced_worst, took);
+			forced += 1;
+		}
+	}
+
+	std::cout << frames << " frames, boomerang limit " << boomerangs << ", inputs delivered " << (RollbackSession::MaxRollback - 1) << " frames late\n";
+	std::cout << "advance (including rollbacks): mean " << (advance_total / (2.0 * frames)) << "us, worst " << advance_worst << "us\n";
+	for (uint32_t p = 0; p < 2; ++p) {
+		std::cout << "  peer " << p << ": " << sessions[p].stats.rollbacks << " rollbacks, " << sessions[p].stats.frames_resimulated << " frames re-simulated, deepest " << sessions[p].stats.deepest_rollback << "\n";
+	}
+	std::cout << RollbackSession::MaxRollback << "-frame rollback (restore + re-simulate): mean " << (forced_total / forced) << "us, worst " << forced_worst << "us"
+	          << " (" << (100.0 * forced_worst / 16000.0) << "% of a 16ms frame)" << std::endl;
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	uint32_t player = 2; //(2 = not set)
+	uint16_t port = 0, peer_port = 0;
+	uint32_t frames = 60 * 30;
+	uint32_t seed = 1;
+	UdpSocket::Conditions conditions;
+	float min_hold = 0.05f, max_hold = 0.5f;
+	bool do_bench = false;
+	uint32_t boomerangs = 1;
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		bool has_value = (argi + 1 < argc);
+		if (arg == "--bench") {
+			do_bench = true;
+		} else if (arg == "--player" && has_value) {
+			player = uint32_t(std::stoul(argv[++argi]));
+		} else if (arg == "--port" && has_value) {
+			port = uint16_t(std::stoul(argv[++argi]));
+		} else if (arg == "--peer-port" && has_value) {
+			peer_port = uint16_t(std::stoul(argv[++argi]));
+		} else if (arg == "--frames" && has_value) {
+			frames = uint32_t(std::stoul(argv[++argi]));
+		} else if (arg == "--seed" && has_value) {
+			seed = uint32_t(std::stoul(argv[++argi]));
+		} else if (arg == "--latency" && has_value) {
+			conditions.latency = std::stof(argv[++argi]) / 1000.0f;
+		} else if (arg == "--jitter" && has_value) {
+			conditions.jitter = std::stof(argv[++argi]) / 1000.0f;
+		} else if (arg == "--loss" && has_value) {
+			conditions.loss = std::stof(argv[++argi]);
+		} else if (arg == "--min-hold" && has_value) {
+			min_hold = std::stof(argv[++argi]);
+		} else if (arg == "--max-hold" && has_value) {
+			max_hold = std::stof(argv[++argi]);
+		} else if (arg == "--boomerangs" && has_value) {
+			boomerangs = uint32_t(std::stoul(argv[++argi]));
+		} else {
+			player = 3; //(print usage)
+			break;
+		}
+	}
+	if (!do_bench && (player > 1 || port == 0 || peer_port == 0)) {
+		std::cerr << "Usage:\n\t" << argv[0] << " --player <0|1> --port <port> --peer-port <port> [--frames <n>] [--seed <n>]\n"
+		             "\t\t[--latency <ms>] [--jitter <ms>] [--loss <fraction>] [--min-hold <seconds>] [--max-hold <seconds>]\n"
+		             "\t" << argv[0] << " --bench [--frames <n>] [--seed <n>] [--boomerangs <n>]" << std::endl;
+		return 1;
+	}
+
+	const std::vector< PPU466::Tile > tiles = GameState::load_tiles();
+
+	if (do_bench) return bench(tiles, frames, seed, boomerangs);
+
+	//------ play ------
+	RollbackSession session(VersusState(tiles, GameState::Tuning(), seed), player, Elapsed);
+	ScriptedPlayer scripted(min_hold, max_hold, seed + 1 + player);
+	UdpSocket socket(port, conditions, seed + 100 + player);
+
+	typedef std::chrono::steady_clock Clock;
+	auto const start = Clock::now();
+	auto const step = std::chrono::duration_cast< Clock::duration >(std::chrono::duration< float >(Elapsed));
+	auto next_tick = start;
+
+	bool have_input = false; //(an input that was decided on, but is waiting out a stall)
+	bool input = false;
+
+	bool done = false;
+	DonePacket ours, theirs;
+	bool have_theirs = false;
+	Clock::time_point done_at;
+
+	while (true) {
+		//take in whatever has arrived:
+		uint8_t buffer[sizeof(RollbackSession::Packet)];
+		while (size_t got = socket.receive(buffer, sizeof(buffer))) {
+			if (got != sizeof(buffer)) continue;
+			uint32_t magic;
+			std::memcpy(&magic, buffer, sizeof(magic));
+			if (magic == RollbackSession::Packet().magic) {
+				RollbackSession::Packet packet;
+				std::memcpy(&packet, buffer, sizeof(packet));
+				session.receive_packet(packet);
+			} else if (magic == DonePacket().magic) {
+				std::memcpy(&theirs, buffer, sizeof(theirs));
+				have_theirs = true;
+			}
+		}
+
+		if (session.frame < frames) {
+			if (!have_input) {
+				input = scripted.next(Elapsed);
+				have_input = true;
+			}
+			if (session.advance(input)) have_input = false;
+		} else if (!done && session.confirmed() == frames) {
+			session.resolve();
+			done = true;
+			done_at = Clock::now();
+			ours.frames = frames;
+			ours.checksum = session.state.checksum();
+			ours.scores[0] = session.state.players[0].score;
+			ours.scores[1] = session.state.players[1].score;
+		}
+
+		//keep sending (inputs, and the result once there is one) until both peers are surely done:
+		RollbackSession::Packet out = session.make_packet();
+		socket.send(peer_port, &out, sizeof(out));
+		if (done) socket.send(peer_port, &ours, sizeof(ours));
+
+		if (done && have_theirs && Clock::now() - done_at > std::chrono::seconds(1)) break;
+		if (Clock::now() - start > step * frames + std::chrono::seconds(30)) {
+			std::cerr << "Timed out (frame " << session.frame << ", confirmed " << session.confirmed() << ")." << std::endl;
+			return 1;
+		}
+
+		next_tick += step;
+		std::this_thread::sleep_until(next_tick);
+	}
+
+	std::cout << "player " << player << ": " << frames << " frames, scores " << ours.scores[0] << " : " << ours.scores[1] << "\n";
+	std::cout << "  " << session.stats.rollbacks << " rollbacks (" << session.stats.frames_resimulated << " frames re-simulated, deepest " << session.stats.deepest_rollback << "), "
+	          << session.stats.stalls << " stalled frames\n";
+	std::cout << "  packets: " << socket.sent << " sent (" << socket.dropped << " dropped by simulated loss), " << socket.received << " received\n";
+	if (theirs.frames != ours.frames || theirs.checksum != ours.checksum) {
+		std::cout << "  DESYNC: checksum " << std::hex << ours.checksum << ", peer has " << theirs.checksum << std::dec << std::endl;
+		return 1;
+	}
+	std::cout << "  in sync with peer (checksum " << std::hex << ours.checksum << std::dec << ")" << std::endl;
+	return 0;
+}
@@ -0,0 +1,77 @@
+//play_replay re-runs a recorded session (see Replay.hpp) headlessly, as fast as possible,
+// checking the state checksum after every frame against the recording.
+//
+//usage:
+//  ./dist/play_replay <file> [--repeat <n>]
+//
+//exits with status 1 (and reports the first bad frame) if the session doesn't replay bit-exactly.
+//With --repeat, the whole session is replayed n times, which makes a steady workload for timing.
+
+#include "GameState.hpp"
+#include "Replay.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	try {
+#endif
+	std::string filename;
+	uint32_t repeat = 1;
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--repeat" && argi + 1 < argc) {
+			repeat = uint32_t(std::stoul(argv[++argi]));
+		} else if (filename.empty() && arg.substr(0,2) != "--") {
+			filename = arg;
+		} else {
+			filename = "";
+			break;
+		}
+	}
+	if (filename.empty() || repeat == 0) {
+		std::cerr << "Usage:\n\t" << argv[0] << " <file> [--repeat <n>]" << std::endl;
+		return 1;
+	}
+
+	Replay replay;
+	replay.load(filename);
+
+	const std::vector< PPU466::Tile > tiles = GameState::load_tiles();
+
+	double simulated = 0.0;
+	int score = 0;
+	uint64_t final_checksum = 0;
+
+	auto before = std::chrono::high_resolution_clock::now();
+	for (uint32_t r = 0; r < repeat; ++r) {
+		GameState game = replay.start(tiles);
+		Replay::Cursor cursor;
+		double time_at_start = game.time_remain;
+		while (cursor.frame < replay.header.frames) {
+			if (!replay.play_frame(&cursor, &game)) {
+				std::cerr << "Replay of '" << filename << "' diverged at frame " << (cursor.frame == 0 ? 0 : cursor.frame - 1) << " of " << replay.header.frames << "." << std::endl;
+				return 1;
+			}
+		}
+		simulated += time_at_start - game.time_remain;
+		score = game.score;
+		final_checksum = game.checksum();
+	}
+	auto after = std::chrono::high_resolution_clock::now();
+	double wall = std::chrono::duration< double >(after - before).count();
+
+	std::cout << "'" << filename << "': " << replay.header.frames << " frames (" << replay.frame_data.size() << " bytes), seed " << replay.header.seed << ", final score " << score << ", final checksum " << std::hex << final_checksum << std::dec << "\n";
+	std::cout << "replayed " << repeat << " time(s) bit-exactly in " << wall << " seconds ("
+	          << (simulated / wall) << "x real time, " << (double(replay.header.frames) * repeat / wall) << " frames per second)" << std::endl;
+
+	return 0;
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	}
+#endif
+}
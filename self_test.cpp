@@ -0,0 +1,262 @@
+//self_test runs headless checks of the engine pieces that are easy to get subtly wrong.
+//
+//usage:
+//  ./dist/self_test
+//
+//prints each check's result; exits with status 1 if any failed.
+
+#include "Level.hpp"
+#include "Metasprite.hpp"
+#include "PPU466.hpp"
+#include "RewindBuffer.hpp"
+#include "SpriteAllocator.hpp"
+#include "WorldStreamer.hpp"
+#include "read_write_chunk.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+//RewindBuffer: fill the arena until it has wrapped and is exactly full, push an unchanged frame,
+// keep going, then step all the way back, checking every capture comes back intact:
+static bool check_rewind_full_ring() {
+	constexpr size_t StateSize = 64;
+	constexpr uint32_t MaxCaptures = 200;
+	bool hit_full_ring = false;
+
+	for (uint32_t seed = 0; seed < 200; ++seed) {
+		std::mt19937 mt(seed);
+		std::vector< uint8_t > state(StateSize);
+		for (auto &b : state) b = uint8_t(mt());
+
+		RewindBuffer rewind({ {state.data(), state.size()} }, MaxCaptures, 300, 10);
+		std::vector< std::vector< uint8_t > > history; //what each capture should restore to
+
+		auto push = [&]() {
+			rewind.push();
+			history.emplace_back(state);
+			if (history.size() > rewind.size()) history.erase(history.begin(), history.end() - rewind.size());
+		};
+		//the arena has wrapped around and has no free bytes left (the end of the newest capture is the start of the oldest):
+		auto ring_is_full = [&]() {
+			if (rewind.size() < 2) return false;
+			RewindBuffer::Capture const &oldest = rewind.capture(0);
+			RewindBuffer::Capture const &newest = rewind.capture(rewind.size() - 1);
+			return oldest.size > 0 && newest.size > 0 && newest.offset < oldest.offset
+				&& newest.offset + newest.size == oldest.offset;
+		};
+
+		push();
+		uint32_t after_full = 0; //pushes left once the ring has been caught full
+		for (uint32_t step = 0; step < 400; ++step) {
+			if (after_full == 0 && ring_is_full() && rewind.since_keyframe + 2 < rewind.keyframe_interval) {
+				hit_full_ring = true;
+				push(); //(unchanged state -- an empty delta)
+				after_full = 20;
+			}
+			state[mt() % StateSize] ^= uint8_t(1 + mt() % 255);
+			push();
+			if (after_full && --after_full == 0) break;
+		}
+
+		//step back through everything held:
+		for (uint32_t i = uint32_t(history.size()) - 1; i > 0; --i) {
+			if (!rewind.step_back() || state != history[i - 1]) {
+				std::cerr << "  (seed " << seed << ": capture " << i - 1 << " of " << history.size() << " didn't come back)\n";
+				return false;
+			}
+		}
+		if (rewind.step_back()) return false; //(nothing is older than the oldest capture)
+	}
+	if (!hit_full_ring) {
+		std::cerr << "  (never caught the ring full; the check didn't check anything)\n";
+		return false;
+	}
+	return true;
+}
+
+//Metasprites: a mirrored metasprite's parts land in the allocator's output, each moved and flipped,
+// and parts hanging off the screen aren't requested:
+static bool check_metasprite_parts() {
+	Metasprites metasprites;
+	//16x16, missing its upper-right part:
+	metasprites.parts = {
+		Metasprites::Part{0, 0, 5, 1},
+		Metasprites::Part{8, 0, 6, uint8_t(2 | PPU466::FlipY)},
+		Metasprites::Part{0, 8, 7, 3},
+	};
+	metasprites.metasprites = { Metasprites::Metasprite{0, 3, 16, 16} };
+
+	SpriteAllocator allocator;
+	allocator.begin();
+	PPU466::Sprite other;
+	other.x = 10; other.y = 20; other.index = 1; other.attributes = 0;
+	allocator.request(other, SpriteAllocator::High);
+	uint32_t requested = metasprites.request(0, glm::ivec2(100, 50), PPU466::FlipX | 0x80, &allocator, SpriteAllocator::Normal);
+	std::array< PPU466::Sprite, 64 > sprites;
+	allocator.finish(&sprites);
+
+	auto key = [](PPU466::Sprite const &s) { return std::array< uint8_t, 4 >{ s.x, s.y, s.index, s.attributes }; };
+	std::vector< std::array< uint8_t, 4 > > got, expected = {
+		key(other),
+		{ 108, 50, 5, uint8_t(1 | PPU466::FlipX | 0x80) }, //(mirrored: the left parts go on the right)
+		{ 100, 50, 6, uint8_t(2 | PPU466::FlipY | PPU466::FlipX | 0x80) },
+		{ 108, 58, 7, uint8_t(3 | PPU466::FlipX | 0x80) },
+	};
+	for (auto const &sprite : sprites) {
+		if (sprite.y < 240) got.emplace_back(key(sprite));
+	}
+	std::sort(got.begin(), got.end());
+	std::sort(expected.begin(), expected.end());
+	if (requested != 3 || got != expected) return false;
+
+	//at the right edge, only the left column of parts fits:
+	allocator.begin();
+	requested = metasprites.request(0, glm::ivec2(250, 50), 0, &allocator, SpriteAllocator::Normal);
+	allocator.finish(&sprites);
+	uint32_t shown = uint32_t(std::count_if(sprites.begin(), sprites.end(), [](PPU466::Sprite const &s) { return s.y < 240; }));
+	return requested == 2 && shown == 2;
+}
+
+//PPU466 scanline limit: with a crowded scanline, the sprites SpriteAllocator placed as Always
+// (the HUD, the player's boomerang) are the ones the limit keeps:
+static bool check_scanline_limit_keeps_always() {
+	constexpr uint8_t AlwaysTile = 200;
+	constexpr uint32_t Limit = 8;
+	SpriteAllocator allocator;
+	allocator.begin();
+	//six Always sprites along the HUD row, requested first, and ten Normal ones (fish) rising into it:
+	for (uint32_t i = 0; i < 6; ++i) {
+		PPU466::Sprite hud;
+		hud.x = uint8_t(8 + i * 8); hud.y = 231; hud.index = AlwaysTile;
+		allocator.request(hud, SpriteAllocator::Always);
+	}
+	for (uint32_t i = 0; i < 10; ++i) {
+		PPU466::Sprite fish;
+		fish.x = uint8_t(100 + i * 9); fish.y = 228; fish.index = uint8_t(i);
+		allocator.request(fish, SpriteAllocator::Normal);
+	}
+	auto ppu = std::make_unique< PPU466 >();
+	allocator.finish(&ppu->sprites);
+
+	auto evaluation = std::make_unique< PPU466::ScanlineEvaluation >();
+	ppu->evaluate_scanlines(Limit, evaluation.get());
+	uint64_t shown = evaluation->shown[232];
+	uint32_t shown_count = 0, shown_always = 0;
+	for (uint32_t i = 0; i < 64; ++i) {
+		if (!(shown >> i & 1)) continue;
+		shown_count += 1;
+		if (ppu->sprites[i].index == AlwaysTile) shown_always += 1;
+	}
+	return evaluation->overflow_scanlines > 0 && shown_count == Limit && shown_always == 6;
+}
+
+//WorldStreamer: scroll a level bigger than the background around (both ways, and past its edges,
+// so background_position goes negative too); the background always matches Levels::copy() of the
+// window, and only the columns and rows scrolled across are streamed in:
+static bool check_world_streamer() {
+	constexpr int32_t W = PPU466::BackgroundWidth, H = PPU466::BackgroundHeight;
+	constexpr uint16_t Outside = 0xabcd;
+
+	//a 200x150 level whose every entry is different (and different from Outside):
+	Levels levels;
+	levels.levels = { Levels::Level{200, 150, 0} };
+	for (uint32_t x = 0; x < 200; ++x) {
+		for (uint32_t y = 0; y < 150; ++y) levels.nametable.emplace_back(uint16_t(x + y * 256));
+	}
+	std::string filename = (std::filesystem::temp_directory_path() / "self_test_levels.chunk").string();
+	{
+		std::ofstream to(filename, std::ios::binary);
+		write_chunk("lvl0", levels.levels, &to);
+		write_chunk("nmt0", levels.nametable, &to);
+	}
+	bool ok = true;
+	{
+		WorldStreamer streamer(filename, 0);
+		streamer.outside = Outside;
+		auto ppu = std::make_unique< PPU466 >();
+		auto expected = std::make_unique< PPU466 >();
+
+		//the window of world tiles that should be loaded for a background_position:
+		// (the screen's 33x31 partly-visible tiles, centered in the 64x60 background)
+		auto floor_div = [](int32_t a, int32_t b) { return (a >= 0 ? a / b : -((-a + b - 1) / b)); };
+		auto window_for = [&](glm::ivec2 const &position) {
+			return glm::ivec2(floor_div(-position.x, 8) - (W - 33) / 2, floor_div(-position.y, 8) - (H - 31) / 2);
+		};
+
+		std::mt19937 mt(0x5eed);
+		glm::ivec2 camera(-400, -300); //(world pixel at the screen's lower left)
+		bool first = true;
+		glm::ivec2 window(0);
+		for (uint32_t step = 0; step < 3000 && ok; ++step) {
+			//mostly small steps either way, sometimes a jump (from well left/below the level to well right/above it):
+			if (step % 250 == 0) {
+				camera = glm::ivec2(int32_t(mt() % 2400) - 500, int32_t(mt() % 2000) - 400);
+			} else {
+				camera += glm::ivec2(int32_t(mt() % 41) - 20, int32_t(mt() % 41) - 20);
+			}
+			ppu->background_position = -camera;
+
+			WorldStreamer::Stats before = streamer.stats;
+			streamer.update(ppu.get());
+			glm::ivec2 want = window_for(ppu->background_position);
+
+			//work done is the tiles crossed (or one whole load, after a jump):
+			glm::ivec2 moved = glm::abs(want - window);
+			if (first || moved.x >= W || moved.y >= H) {
+				ok = ok && streamer.stats.full_loads == before.full_loads + 1
+					&& streamer.stats.columns == before.columns + uint64_t(W) && streamer.stats.rows == before.rows;
+			} else {
+				ok = ok && streamer.stats.full_loads == before.full_loads
+					&& streamer.stats.columns == before.columns + uint64_t(moved.x)
+					&& streamer.stats.rows == before.rows + uint64_t(moved.y);
+			}
+			window = want;
+			first = false;
+
+			//...and the background holds that window, wrapped, with Outside past the level's edges:
+			expected->background.fill(Outside);
+			glm::ivec2 from = glm::max(window, glm::ivec2(0));
+			glm::ivec2 to = window + glm::ivec2(W, H);
+			if (to.x > from.x && to.y > from.y) {
+				levels.copy(0, glm::uvec2(from), glm::uvec2(to - from), expected.get());
+			}
+			if (ppu->background != expected->background) ok = false;
+			if (!ok) std::cerr << "  (went wrong at step " << step << ", camera " << camera.x << ", " << camera.y << ")\n";
+		}
+	}
+	std::filesystem::remove(filename);
+	return ok;
+}
+
+int main() {
+	struct Check {
+		std::string name;
+		std::function< bool() > run;
+	};
+	std::vector< Check > checks = {
+		{"RewindBuffer: unchanged frame pushed into a full ring", check_rewind_full_ring},
+		{"Metasprites: mirrored parts land in the sprite allocator's output", check_metasprite_parts},
+		{"PPU466: the scanline limit keeps SpriteAllocator's Always sprites", check_scanline_limit_keeps_always},
+		{"WorldStreamer: background matches the level window as it scrolls", check_world_streamer},
+	};
+
+	uint32_t failed = 0;
+	for (auto const &check : checks) {
+		bool ok = check.run();
+		std::cout << (ok ? "ok     " : "FAILED ") << check.name << std::endl;
+		if (!ok) failed += 1;
+	}
+	if (failed) {
+		std::cout << failed << " of " << checks.size() << " checks failed." << std::endl;
+		return 1;
+	}
+	return 0;
+}
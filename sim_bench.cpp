@@ -0,0 +1,141 @@
+//sim_bench runs GameState::update as fast as possible, with no window or GL context,
+// driven by a simple scripted player, and reports how fast the simulation runs.
+//
+//usage:
+//  ./dist/sim_bench [--ticks <n>] [--tick-rate <hz>] [--boomerangs <n>] [--hold <seconds>] [--record <file>] [--checksum]
+//
+//With --checksum, GameState::checksum() is also computed after every tick (and its cost reported).
+//
+//With --record, the first session is saved as a replay (see Replay.hpp), so 'play_replay <file>' can re-run it.
+
+#include "GameState.hpp"
+#include "ScriptedPlayer.hpp"
+#include "Replay.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+//---- allocation counting ----
+//every heap allocation in the process goes through these:
+static std::atomic< uint64_t > allocation_count(0);
+
+void *operator new(std::size_t size) {
+	allocation_count += 1;
+	if (void *ptr = std::malloc(size ? size : 1)) return ptr;
+	throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+void operator delete(void *ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+
+int main(int argc, char **argv) {
+	uint64_t ticks = 1000000; //number of updates to run
+	float tick_rate = 60.0f; //updates per simulated second
+	uint32_t boomerangs = 1; //GameState::boomerang_limit (raise for a load test)
+	float hold = 0.5f; //how long the scripted player holds space before each throw
+	std::string record_filename; //if set, save the first session here
+	bool checksum = false; //compute a checksum every tick?
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--ticks" && argi + 1 < argc) {
+			ticks = std::stoull(argv[++argi]);
+		} else if (arg == "--tick-rate" && argi + 1 < argc) {
+			tick_rate = std::stof(argv[++argi]);
+		} else if (arg == "--boomerangs" && argi + 1 < argc) {
+			boomerangs = uint32_t(std::stoul(argv[++argi]));
+		} else if (arg == "--hold" && argi + 1 < argc) {
+			hold = std::stof(argv[++argi]);
+		} else if (arg == "--record" && argi + 1 < argc) {
+			record_filename = argv[++argi];
+		} else if (arg == "--checksum") {
+			checksum = true;
+		} else {
+			std::cerr << "Usage:\n\t" << argv[0] << " [--ticks <n>] [--tick-rate <hz>] [--boomerangs <n>] [--hold <seconds>] [--record <file>] [--checksum]" << std::endl;
+			return 1;
+		}
+	}
+	if (tick_rate <= 0.0f) {
+		std::cerr << "--tick-rate must be positive." << std::endl;
+		return 1;
+	}
+	const float elapsed = 1.0f / tick_rate;
+
+	//every session starts from a copy of this:
+	GameState initial(GameState::load_tiles());
+	initial.boomerang_limit = boomerangs;
+
+	GameState game = initial;
+
+	//scripted player: hold space for 'hold' seconds, let go for one tick, repeat:
+	ScriptedPlayer player(hold, hold, 0);
+
+	//recording (reserved up front so it doesn't show up in the allocation count):
+	Replay recording;
+	Replay *record = nullptr;
+	if (!record_filename.empty()) {
+		recording.begin(initial);
+		recording.frame_data.reserve(size_t(initial.tuning.session_length * tick_rate + 2) * 16);
+		recording.pending_inputs.reserve(4);
+		record = &recording;
+	}
+
+	uint64_t sessions = 0;
+	int64_t total_score = 0;
+	uint64_t checksums = 0; //(xor of all checksums, so they can't be optimized away)
+	double checksum_seconds = 0.0;
+
+	uint64_t allocations_before = allocation_count;
+	auto before = std::chrono::high_resolution_clock::now();
+
+	for (uint64_t t = 0; t < ticks; ++t) {
+		player.drive(game, elapsed, record);
+		game.update(elapsed);
+		if (record) record->record_frame(elapsed, game);
+		if (checksum) {
+			auto checksum_before = std::chrono::high_resolution_clock::now();
+			checksums ^= game.checksum();
+			checksum_seconds += std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - checksum_before).count();
+		}
+
+		if (game.game_stop) {
+			record = nullptr; //(only the first session is recorded)
+			sessions += 1;
+			total_score += game.score;
+			game = initial;
+		}
+	}
+
+	auto after = std::chrono::high_resolution_clock::now();
+	uint64_t allocations = allocation_count - allocations_before;
+
+	double wall = std::chrono::duration< double >(after - before).count();
+	double simulated = double(ticks) * double(elapsed);
+
+	std::cout << "ticks: " << ticks << " at " << tick_rate << " Hz (" << simulated << " simulated seconds)\n";
+	std::cout << "boomerang limit: " << boomerangs << "\n";
+	std::cout << "wall time: " << wall << " seconds\n";
+	std::cout << "simulated seconds per wall second: " << (simulated / wall) << "\n";
+	std::cout << "ticks per wall second: " << (double(ticks) / wall) << "\n";
+	std::cout << "allocations: " << allocations << " (" << (double(allocations) / double(ticks)) << " per tick)\n";
+	if (checksum) {
+		std::cout << "checksum: " << (checksum_seconds / double(ticks) * 1e6) << "us per tick (all checksums xor'd: " << std::hex << checksums << std::dec << ")\n";
+	}
+	std::cout << "sessions finished: " << sessions;
+	if (sessions) std::cout << " (mean score " << (double(total_score) / double(sessions)) << ")";
+	std::cout << std::endl;
+
+	if (!record_filename.empty()) {
+		recording.save(record_filename);
+		std::cout << "recorded " << recording.header.frames << " frames (" << recording.frame_data.size() << " bytes) to '" << record_filename << "'" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,60 @@
+#include "swept_collide.hpp"
+
+#include "PPU466.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+bool swept_box_overlap(
+	glm::vec2 const &a0, glm::vec2 const &a1,
+	glm::vec2 const &b0, glm::vec2 const &b1,
+	float *t_enter_, float *t_exit_) {
+	assert(t_enter_);
+	assert(t_exit_);
+
+	//work in b's position relative to a, which moves from rel0 to rel0 + delta over the step:
+	glm::vec2 rel0 = b0 - a0;
+	glm::vec2 delta = (b1 - b0) - (a1 - a0);
+
+	float t_enter = 0.0f;
+	float t_exit = 1.0f;
+	for (uint32_t axis = 0; axis < 2; ++axis) {
+		//boxes overlap on this axis while -8 < rel < 8:
+		if (delta[axis] == 0.0f) {
+			if (std::abs(rel0[axis]) >= 8.0f) return false;
+		} else {
+			float t0 = (-8.0f - rel0[axis]) / delta[axis];
+			float t1 = ( 8.0f - rel0[axis]) / delta[axis];
+			t_enter = std::max(t_enter, std::min(t0, t1));
+			t_exit = std::min(t_exit, std::max(t0, t1));
+		}
+	}
+	if (t_enter > t_exit) return false;
+
+	*t_enter_ = t_enter;
+	*t_exit_ = t_exit;
+	return true;
+}
+
+bool swept_tiles_overlap(
+	uint64_t a_mask, glm::vec2 const &a0, glm::vec2 const &a1,
+	uint64_t b_mask, glm::vec2 const &b0, glm::vec2 const &b1) {
+
+	float t_enter, t_exit;
+	if (!swept_box_overlap(a0, a1, b0, b1, &t_enter, &t_exit)) return false;
+
+	//sample the overlap interval often enough that neither tile moves a whole pixel between samples:
+	glm::vec2 travel = glm::abs(a1 - a0) + glm::abs(b1 - b0);
+	float pixels = std::max(travel.x, travel.y) * (t_exit - t_enter);
+	uint32_t steps = uint32_t(std::ceil(pixels));
+
+	for (uint32_t s = 0; s <= steps; ++s) {
+		float t = (steps == 0 ? t_exit : t_enter + (t_exit - t_enter) * (float(s) / float(steps)));
+		//truncate to whole pixels the same way sprites are placed on screen:
+		glm::ivec2 a = glm::ivec2(a0 + (a1 - a0) * t);
+		glm::ivec2 b = glm::ivec2(b0 + (b1 - b0) * t);
+		if (PPU466::opacity_masks_overlap(a_mask, b_mask, b - a)) return true;
+	}
+	return false;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+/*
+ * Continuous ("swept") collision tests for 8x8 tiles that both move during a simulation step.
+ *
+ * Each tile is assumed to move in a straight line from its position at the start of the step
+ *  to its position at the end of the step; positions are lower-left corners, in pixels.
+ *
+ * Testing the whole path (instead of only the end-of-step positions) means fast objects
+ *  can't tunnel through each other, even with large timesteps.
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+//Box part of the test:
+// returns true if the 8x8 boxes of tile a (moving a0 -> a1) and tile b (moving b0 -> b1) overlap during the step,
+// and sets [*t_enter, *t_exit] (a subset of [0,1]) to the fraction of the step during which they overlap.
+bool swept_box_overlap(
+	glm::vec2 const &a0, glm::vec2 const &a1,
+	glm::vec2 const &b0, glm::vec2 const &b1,
+	float *t_enter, float *t_exit);
+
+//Full test:
+// a_mask / b_mask are tile opacity masks (see PPU466::Tile::opacity_mask())
+// returns true if any opaque pixels of the two tiles touch at some point during the step.
+//The box test rejects most pairs; the pixel test is sampled (at whole-pixel resolution) only
+// over the part of the step where the boxes overlap.
+bool swept_tiles_overlap(
+	uint64_t a_mask, glm::vec2 const &a0, glm::vec2 const &a1,
+	uint64_t b_mask, glm::vec2 const &b0, glm::vec2 const &b1);